@@ -0,0 +1,916 @@
+#include <stdint.h>
+#include <limits>
+#include <vector>
+#include <string>
+
+#include <chrono>
+#include <numeric>
+#include <iostream>
+#include <iomanip>
+#include <algorithm>
+
+#include "../tape/timer.h"
+#include "../tape/statistic.h"
+#include "../tape/vbyte_descriptor.h"
+#include "../tape/stream_vbyte_descriptor.h"
+#include "../tape/group_varint_descriptor.h"
+#include "../tape/pfor_descriptor.h"
+#include "../tape/adaptive_descriptor.h"
+#include "../tape/ordered_integer_descriptor.h"
+#include "../tape/delta_tape.h"
+#include "../tape/gorilla_descriptor.h"
+#include "../tape/transcode.h"
+#include "../tape/tape_of_tapes.h"
+#include "../tape/cpu_dispatch.h"
+#include "../tape/hybrid_set.h"
+#include "../tape/allocation_policy.h"
+#include "../tape/small_extent.h"
+#include "../tape/shared_extent.h"
+#include "../tape/segmented_tape.h"
+#include "../tape/gap_buffer_tape.h"
+#include "../tape/tape.h"
+
+template <typename T>
+void print_cell(const T& x, int precision = 0) {
+  std::cout << "\t" << std::setw(6)
+            << std::fixed << std::setprecision(precision)
+            << x << std::flush;
+}
+
+// Columns: bytes per value and nanoseconds per value for each codec;
+// vbyte is decoded through the iterators, in bulk, and in bulk as the
+// gaps of a delta_tape (with the prefix sum), the block codecs (32-bit
+// values only, but for adaptive) in bulk
+
+// returns nanoseconds per value of summing the tape through its iterators
+template <typename Tape>
+double time_iterator_decode(const Tape& t, size_t iterations) {
+  uint64_t sum(0);
+  timer tm;
+  tm.start();
+  for (size_t i = 0; i < iterations; ++i) {
+    sum += std::accumulate(t.begin(), t.end(), uint64_t(0));
+  }
+  double result = tm.stop();
+  if (sum == 1) std::cout << " ";   // keep the sum alive
+  return result / double(iterations * t.size());
+}
+
+// returns nanoseconds per value of summing the tape by bulk decoding it
+// through an L1-sized buffer of T
+template <typename T, typename Tape>
+double time_bulk_decode(const Tape& t, size_t iterations) {
+  const size_t buffer_size = 1024;
+  T buffer[buffer_size];
+  T sum(0);
+  size_t n(0);
+  timer tm;
+  tm.start();
+  for (size_t i = 0; i < iterations; ++i) {
+    typename Tape::const_iterator cursor = t.begin();
+    size_t m;
+    while ((m = t.decode_block(cursor, buffer, buffer_size)) != 0) {
+      sum = std::accumulate(buffer, buffer + m, sum);
+      n += m;
+    }
+  }
+  double result = tm.stop();
+  if (sum == 1) std::cout << " ";
+  return result / double(n);
+}
+
+// returns nanoseconds per value of summing the values of a delta_tape
+// whose gaps are the values of the tape
+template <typename Tape>
+double time_delta_decode(const Tape& t, size_t iterations) {
+  typedef typename Tape::value_type T;
+  const size_t buffer_size = 1024;
+  T buffer[buffer_size];
+  uint64_t sum(0);
+  size_t n(0);
+  timer tm;
+  tm.start();
+  for (size_t i = 0; i < iterations; ++i) {
+    const uint8_t* first = t.get_extent().storage();
+    const uint8_t* last = t.get_extent().content_end();
+    T base(0);
+    while (first != last) {
+      std::pair<const uint8_t*, T*> p =
+        delta_decode_n(first, last, buffer_size, buffer, base, t.descriptor());
+      sum += p.second[-1];
+      base = p.second[-1];
+      n += p.second - buffer;
+      first = p.first;
+    }
+  }
+  double result = tm.stop();
+  if (sum == 1) std::cout << " ";
+  return result / double(n);
+}
+
+template <typename BlockTape, typename T>
+void print_block_codec(const std::vector<uint64_t>& v, size_t iterations) {
+  if (*std::max_element(begin(v), end(v)) > std::numeric_limits<T>::max()) {
+    print_cell("-");
+    print_cell("-");
+    return;
+  }
+  BlockTape t;
+  append_blocks(t, begin(v), end(v));
+  print_cell(double(t.get_extent().byte_size()) / double(v.size()), 2);
+  print_cell(time_bulk_decode<T>(t, iterations), 2);
+}
+
+template <typename Generator>
+std::vector<uint64_t> generate(size_t n, Generator gen) {
+  std::vector<uint64_t> result(n);
+  std::generate(begin(result), end(result), gen);
+  return result;
+}
+
+struct zipf_gaps {
+  zipf z;
+  zipf_gaps(uint64_t n) : z(n) {}
+  uint64_t operator()() { return z.random(); }
+};
+
+struct exponential_gaps {
+  exponential e;
+  exponential_gaps(double mu) : e(mu) {}
+  uint64_t operator()() { return uint64_t(e.random()); }
+};
+
+struct random_words {
+  uint64_t operator()() { return uint64_t(lrand48()) << 32 | uint64_t(lrand48()); }
+};
+
+void run_decode_test(const std::string& name, const std::vector<uint64_t>& v,
+                     size_t iterations) {
+  typedef tape<vbyte_descriptor> vbyte_tape;
+  vbyte_tape t(begin(v), end(v));
+  std::cout << std::setw(16) << name;
+  print_cell(double(t.get_extent().byte_size()) / double(v.size()), 2);
+  print_cell(time_iterator_decode(t, iterations), 2);
+  print_cell(time_bulk_decode<uint64_t>(t, iterations), 2);
+  print_cell(time_delta_decode(t, iterations), 2);
+  print_block_codec<tape<stream_vbyte_descriptor>, uint32_t>(v, iterations);
+  print_block_codec<tape<group_varint_descriptor>, uint32_t>(v, iterations);
+  print_block_codec<tape<pfor_descriptor>, uint32_t>(v, iterations);
+  print_block_codec<tape<adaptive_descriptor>, uint64_t>(v, iterations);
+  std::cout << std::endl;
+}
+
+// Kernels: nanoseconds per value of the vbyte bulk functions at every
+// level of cpu_dispatch.h up to the level of the machine
+
+void run_kernel_test(const std::vector<uint64_t>& v, size_t iterations) {
+  const cpu_level detected = detect_cpu_level();
+  const char* names[] = { "scalar", "sse4.1", "avx2", "avx512" };
+  vbyte_descriptor dsc;
+  const uint64_t* first = &v[0];
+  const uint64_t* last = first + v.size();
+  std::vector<uint8_t> encoded(dsc.encoded_size(~uint64_t(0)) * v.size());
+  std::vector<uint64_t> decoded(v.size());
+  for (int level = scalar_cpu; level <= detected; ++level) {
+    set_cpu_level(cpu_level(level));
+    size_t bytes(0);
+    timer tm;
+    tm.start();
+    for (size_t i = 0; i < iterations; ++i) bytes += total_encoded_size(first, last, dsc).first;
+    double size_time = tm.stop();
+    uint8_t* encoded_last(NULL);
+    tm.start();
+    for (size_t i = 0; i < iterations; ++i) encoded_last = encode_range(first, last, &encoded[0], dsc);
+    double encode_time = tm.stop();
+    tm.start();
+    for (size_t i = 0; i < iterations; ++i) {
+      decode_n(&encoded[0], encoded_last, v.size(), &decoded[0], dsc);
+    }
+    double decode_time = tm.stop();
+    if (bytes != iterations * size_t(encoded_last - &encoded[0]) || decoded != v) {
+      std::cout << "wrong result";
+    }
+    double n = double(iterations * v.size());
+    std::cout << std::setw(16) << names[level];
+    print_cell(size_time / n, 2);
+    print_cell(encode_time / n, 2);
+    print_cell(decode_time / n, 2);
+    std::cout << std::endl;
+  }
+  set_cpu_level(detected);
+}
+
+// Transcoding: nanoseconds per value of re-encoding a vbyte tape by
+// pushing back every value, by constructing from the iterators, and by
+// transcode
+
+template <typename Tape>
+double time_push_back(const tape<vbyte_descriptor>& x) {
+  timer tm;
+  tm.start();
+  Tape result;
+  for (tape<vbyte_descriptor>::const_iterator i = x.begin(); i != x.end(); ++i) {
+    result.push_back(*i);
+  }
+  double t = tm.stop();
+  if (result.size() != x.size()) std::cout << "wrong size";
+  return t / double(x.size());
+}
+
+template <typename Tape>
+double time_construct(const tape<vbyte_descriptor>& x) {
+  timer tm;
+  tm.start();
+  Tape result(x.begin(), x.end());
+  double t = tm.stop();
+  if (result.size() != x.size()) std::cout << "wrong size";
+  return t / double(x.size());
+}
+
+template <typename Tape>
+double time_transcode(const tape<vbyte_descriptor>& x) {
+  timer tm;
+  tm.start();
+  Tape result = transcode<typename Tape::descriptor_type>(x);
+  double t = tm.stop();
+  if (result.size() != x.size()) std::cout << "wrong size";
+  return t / double(x.size());
+}
+
+void run_transcode_test(const std::string& name, const std::vector<uint64_t>& v) {
+  typedef tape<ordered_integer_descriptor> ordered_tape;
+  tape<vbyte_descriptor> t(begin(v), end(v));
+  std::cout << std::setw(16) << name;
+  print_cell(time_push_back<ordered_tape>(t), 2);
+  print_cell(time_construct<ordered_tape>(t), 2);
+  print_cell(time_transcode<ordered_tape>(t), 2);
+  std::cout << std::endl;
+}
+
+// Nesting: bytes per value and nanoseconds per value of building and of
+// summing lists of gaps stored as a vector of tapes (counting the headers
+// of the tapes and of their extents) and as a tape_of_tapes
+
+std::vector<std::vector<uint64_t> > generate_lists(size_t n, size_t length, uint64_t range) {
+  std::vector<std::vector<uint64_t> > result(n);
+  zipf z(range);
+  for (size_t i = 0; i < n; ++i) {
+    for (size_t j = 0, m = 1 + i % (2 * length); j < m; ++j) result[i].push_back(z.random());
+  }
+  return result;
+}
+
+template <typename Container>
+uint64_t sum_lists(const Container& x) {
+  uint64_t sum(0);
+  for (typename Container::const_iterator i = x.begin(); i != x.end(); ++i) {
+    sum = std::accumulate((*i).begin(), (*i).end(), sum);
+  }
+  return sum;
+}
+
+void run_nesting_test(const std::string& name, size_t n, size_t length) {
+  typedef tape<vbyte_descriptor> vbyte_tape;
+  std::vector<std::vector<uint64_t> > lists = generate_lists(n, length, 1 << 16);
+  size_t values(0);
+  for (size_t i = 0; i < n; ++i) values += lists[i].size();
+
+  timer tm;
+  tm.start();
+  std::vector<vbyte_tape> tapes;
+  for (size_t i = 0; i < n; ++i) tapes.push_back(vbyte_tape(begin(lists[i]), end(lists[i])));
+  double vector_build = tm.stop();
+  tm.start();
+  uint64_t vector_sum = sum_lists(tapes);
+  double vector_time = tm.stop();
+  size_t vector_bytes = tapes.size() * sizeof(vbyte_tape);
+  for (size_t i = 0; i < n; ++i) vector_bytes += tapes[i].get_extent().total_byte_size();
+
+  tm.start();
+  tape_of_tapes<vbyte_descriptor> nested;
+  for (size_t i = 0; i < n; ++i) nested.push_back(begin(lists[i]), end(lists[i]));
+  double nested_build = tm.stop();
+  tm.start();
+  uint64_t nested_sum = sum_lists(nested);
+  double nested_time = tm.stop();
+  size_t nested_bytes = nested.get_tapes().get_extent().total_byte_size();
+
+  if (vector_sum != nested_sum) std::cout << "wrong sum";
+  std::cout << std::setw(16) << name;
+  print_cell(double(vector_bytes) / double(values), 2);
+  print_cell(vector_build / double(values), 2);
+  print_cell(vector_time / double(values), 2);
+  print_cell(double(nested_bytes) / double(values), 2);
+  print_cell(nested_build / double(values), 2);
+  print_cell(nested_time / double(values), 2);
+  std::cout << std::endl;
+}
+
+// Allocating: nanoseconds per value of building lists of gaps by pushing
+// their values one at a time into tapes with the malloc, pool and arena
+// allocation policies, and of destroying the tapes (releasing the arena)
+
+template <typename Allocator>
+std::pair<double, double> time_allocation(const std::vector<std::vector<uint64_t> >& lists,
+                                          arena* a) {
+  typedef tape<vbyte_descriptor, Allocator> tape_type;
+  timer tm;
+  tm.start();
+  std::vector<tape_type> tapes(lists.size());
+  for (size_t i = 0; i < lists.size(); ++i) {
+    for (size_t j = 0; j < lists[i].size(); ++j) tapes[i].push_back(lists[i][j]);
+  }
+  double build = tm.stop();
+  tm.start();
+  std::vector<tape_type>().swap(tapes);
+  if (a) a->release();
+  return std::make_pair(build, tm.stop());
+}
+
+void run_allocation_test(const std::string& name, size_t n, size_t length) {
+  std::vector<std::vector<uint64_t> > lists = generate_lists(n, length, 1 << 16);
+  size_t values(0);
+  for (size_t i = 0; i < n; ++i) values += lists[i].size();
+
+  std::pair<double, double> malloc_time = time_allocation<malloc_allocator>(lists, NULL);
+  std::pair<double, double> pool_time = time_allocation<pool_allocator<> >(lists, NULL);
+  arena a;
+  arena_scope<> scope(a);
+  std::pair<double, double> arena_time = time_allocation<arena_allocator<> >(lists, &a);
+
+  std::cout << std::setw(16) << name;
+  print_cell(malloc_time.first / double(values), 2);
+  print_cell(malloc_time.second / double(values), 2);
+  print_cell(pool_time.first / double(values), 2);
+  print_cell(pool_time.second / double(values), 2);
+  print_cell(arena_time.first / double(values), 2);
+  print_cell(arena_time.second / double(values), 2);
+  std::cout << std::endl;
+}
+
+// Appending: nanoseconds per value of building a tape from the gaps of
+// sorted document numbers (computed by adjacent_difference beforehand):
+// copying them into the back_inserter of the tape, appending them, and
+// appending them through an input iterator (a buffer at a time)
+
+template <typename Iterator>
+struct input_only_iterator {
+  typedef std::input_iterator_tag iterator_category;
+  typedef typename std::iterator_traits<Iterator>::value_type value_type;
+  typedef typename std::iterator_traits<Iterator>::difference_type difference_type;
+  typedef const value_type* pointer;
+  typedef const value_type& reference;
+
+  Iterator i;
+  explicit input_only_iterator(Iterator i) : i(i) {}
+  reference operator*() const { return *i; }
+  input_only_iterator& operator++() {
+    ++i;
+    return *this;
+  }
+  input_only_iterator operator++(int) {
+    input_only_iterator tmp(*this);
+    ++i;
+    return tmp;
+  }
+  friend bool operator==(const input_only_iterator& x, const input_only_iterator& y) {
+    return x.i == y.i;
+  }
+  friend bool operator!=(const input_only_iterator& x, const input_only_iterator& y) {
+    return x.i != y.i;
+  }
+};
+
+void run_append_test(const std::string& name, const std::vector<uint64_t>& v) {
+  typedef tape<vbyte_descriptor> vbyte_tape;
+  std::vector<uint64_t> documents(v.size());
+  std::partial_sum(begin(v), end(v), begin(documents));
+  std::vector<uint64_t> gaps(documents.size());
+  std::adjacent_difference(begin(documents), end(documents), begin(gaps));
+  double n = double(gaps.size());
+  timer tm;
+
+  tm.start();
+  vbyte_tape inserted;
+  std::copy(begin(gaps), end(gaps), inserted.back_inserter());
+  double inserter_time = tm.stop();
+
+  tm.start();
+  vbyte_tape appended;
+  appended.append(begin(gaps), end(gaps));
+  double forward_time = tm.stop();
+
+  tm.start();
+  vbyte_tape input;
+  typedef input_only_iterator<std::vector<uint64_t>::const_iterator> input_iterator;
+  input.append(input_iterator(gaps.begin()), input_iterator(gaps.end()));
+  double input_time = tm.stop();
+
+  if (inserted != appended || input != appended) std::cout << "wrong tape";
+  std::cout << std::setw(16) << name;
+  print_cell(inserter_time / n, 2);
+  print_cell(forward_time / n, 2);
+  print_cell(input_time / n, 2);
+  std::cout << std::endl;
+}
+
+// Growing: nanoseconds per value of pushing all values one at a time into
+// a single tape, moving the contents to a new block on every doubling, and
+// resizing the block with realloc when growing by 2x, 1.5x and exactly
+
+struct copying_allocator {
+  static void* allocate(size_t n) { return malloc_allocator::allocate(n); }
+  static void deallocate(void* p, size_t n) { malloc_allocator::deallocate(p, n); }
+  static void* reallocate(void*, size_t, size_t) { return NULL; }
+};
+
+template <typename Allocator, typename Growth>
+double time_growth(const std::vector<uint64_t>& v) {
+  timer tm;
+  tm.start();
+  tape<vbyte_descriptor, Allocator, Growth> t;
+  for (size_t i = 0; i < v.size(); ++i) t.push_back(v[i]);
+  double time = tm.stop();
+  if (t.size() != v.size()) std::cout << "wrong size";
+  return time / double(v.size());
+}
+
+void run_growth_test(const std::string& name, const std::vector<uint64_t>& v) {
+  std::cout << std::setw(16) << name;
+  print_cell(time_growth<copying_allocator, doubling_growth>(v), 2);
+  print_cell(time_growth<malloc_allocator, doubling_growth>(v), 2);
+  print_cell(time_growth<malloc_allocator, one_and_a_half_growth>(v), 2);
+  print_cell(time_growth<malloc_allocator, exact_growth>(v), 2);
+  std::cout << std::endl;
+}
+
+// Logging: nanoseconds per value of pushing all values one at a time
+// into a tape moving its contents on every doubling, a tape resized with
+// realloc and a segmented_tape, and of decoding each of them through a
+// buffer of 256 values with decode_block
+
+template <typename Tape>
+void time_logging(const std::vector<uint64_t>& v) {
+  timer tm;
+  tm.start();
+  Tape t;
+  for (size_t i = 0; i < v.size(); ++i) t.push_back(v[i]);
+  print_cell(tm.stop() / double(v.size()), 2);
+
+  const size_t buffer_size(256);
+  uint64_t buffer[buffer_size];
+  uint64_t sum(0);
+  tm.start();
+  typename Tape::const_iterator cursor = t.begin();
+  size_t m;
+  while ((m = t.decode_block(cursor, buffer, buffer_size)) != 0) {
+    sum = std::accumulate(buffer, buffer + m, sum);
+  }
+  double time = tm.stop();
+  if (sum != std::accumulate(v.begin(), v.end(), uint64_t(0))) std::cout << "wrong sum";
+  print_cell(time / double(v.size()), 2);
+}
+
+void run_logging_test(const std::string& name, const std::vector<uint64_t>& v) {
+  std::cout << std::setw(16) << name;
+  time_logging<tape<vbyte_descriptor, copying_allocator> >(v);
+  time_logging<tape<vbyte_descriptor> >(v);
+  time_logging<segmented_tape<vbyte_descriptor> >(v);
+  std::cout << std::endl;
+}
+
+// Patching: nanoseconds per value of inserting values one after another
+// in the middle of a list, into a tape and into a gap_buffer_tape
+
+template <typename Tape>
+double time_patching(const std::vector<uint64_t>& v, const std::vector<uint64_t>& patch,
+                     Tape& t) {
+  timer tm;
+  tm.start();
+  typename Tape::const_iterator position = t.begin();
+  std::advance(position, v.size() / 2);
+  for (size_t i = 0; i < patch.size(); ++i) {
+    position = t.insert(position, &patch[i], &patch[i] + 1).second;
+  }
+  return tm.stop() / double(patch.size());
+}
+
+void run_patching_test(const std::string& name, const std::vector<uint64_t>& v, size_t n) {
+  std::vector<uint64_t> patch(v.begin(), v.begin() + n);
+  tape<vbyte_descriptor> t(v.begin(), v.end());
+  gap_buffer_tape<vbyte_descriptor> g(v.begin(), v.end());
+  std::cout << std::setw(16) << name;
+  print_cell(time_patching(v, patch, t), 2);
+  print_cell(time_patching(v, patch, g), 2);
+  if (!std::equal(t.begin(), t.end(), g.begin())) std::cout << "wrong tape";
+  std::cout << std::endl;
+}
+
+// Small tapes: bytes per list (the tape objects and their extents),
+// allocations per list and nanoseconds per list of building a vector of
+// short lists of gaps stored in tapes with an extent and with a
+// small_extent
+
+struct counting_allocator {
+  static size_t& allocations() {
+    static size_t n = 0;
+    return n;
+  }
+  static void* allocate(size_t n) {
+    ++allocations();
+    return malloc_allocator::allocate(n);
+  }
+  static void deallocate(void* p, size_t n) { malloc_allocator::deallocate(p, n); }
+  static void* reallocate(void* p, size_t n, size_t m) {
+    ++allocations();
+    return malloc_allocator::reallocate(p, n, m);
+  }
+};
+
+template <typename Tape>
+void time_small_tapes(const std::vector<std::vector<uint64_t> >& lists) {
+  counting_allocator::allocations() = 0;
+  timer tm;
+  tm.start();
+  std::vector<Tape> tapes(lists.size());
+  for (size_t i = 0; i < lists.size(); ++i) {
+    for (size_t j = 0; j < lists[i].size(); ++j) tapes[i].push_back(lists[i][j]);
+  }
+  double time = tm.stop();
+  size_t bytes = tapes.size() * sizeof(Tape);
+  for (size_t i = 0; i < tapes.size(); ++i) bytes += tapes[i].get_extent().total_byte_size();
+  print_cell(double(bytes) / double(lists.size()), 2);
+  print_cell(double(counting_allocator::allocations()) / double(lists.size()), 2);
+  print_cell(time / double(lists.size()), 2);
+}
+
+void run_small_tape_test(const std::string& name, size_t n, size_t length) {
+  std::vector<std::vector<uint64_t> > lists = generate_lists(n, length, 1 << 16);
+  std::cout << std::setw(16) << name;
+  time_small_tapes<tape<vbyte_descriptor, counting_allocator> >(lists);
+  time_small_tapes<tape<vbyte_descriptor, counting_allocator, doubling_growth, small_extent> >(lists);
+  std::cout << std::endl;
+}
+
+// Intersecting: bytes per value and nanoseconds per value (of both
+// inputs) of intersecting two random sets of document numbers stored as
+// delta_tape<vbyte_descriptor> and as hybrid_set
+
+std::vector<uint64_t> random_set(size_t universe, double density) {
+  std::vector<uint64_t> result;
+  bernoulli b(density);
+  for (size_t x = 0; x < universe; ++x) if (b.random()) result.push_back(x);
+  return result;
+}
+
+void run_intersection_test(const std::string& name, size_t universe,
+                           double density1, double density2, size_t iterations) {
+  std::vector<uint64_t> v1 = random_set(universe, density1);
+  std::vector<uint64_t> v2 = random_set(universe, density2);
+  double n = double(iterations * (v1.size() + v2.size()));
+
+  delta_tape<vbyte_descriptor> d1(begin(v1), end(v1));
+  delta_tape<vbyte_descriptor> d2(begin(v2), end(v2));
+  std::vector<uint64_t> result;
+  timer tm;
+  tm.start();
+  for (size_t i = 0; i < iterations; ++i) {
+    result.clear();
+    std::set_intersection(d1.begin(), d1.end(), d2.begin(), d2.end(), std::back_inserter(result));
+  }
+  double delta_time = tm.stop();
+  size_t delta_bytes = d1.get_gaps().get_extent().byte_size() + d2.get_gaps().get_extent().byte_size();
+
+  hybrid_set h1(begin(v1), end(v1));
+  hybrid_set h2(begin(v2), end(v2));
+  hybrid_set h;
+  tm.start();
+  for (size_t i = 0; i < iterations; ++i) h = set_intersection(h1, h2);
+  double hybrid_time = tm.stop();
+
+  if (h.size() != result.size()) std::cout << "wrong size";
+  std::cout << std::setw(16) << name;
+  print_cell(double(delta_bytes) / double(v1.size() + v2.size()), 2);
+  print_cell(delta_time / n, 2);
+  print_cell(double(h1.byte_size() + h2.byte_size()) / double(v1.size() + v2.size()), 2);
+  print_cell(hybrid_time / n, 2);
+  std::cout << std::endl;
+}
+
+// Sorting tapes as keys: order_preserving descriptors compare the bytes
+// of the extents, the others decode element by element
+
+template <typename Tape>
+struct less_by_pointer {
+  bool operator()(const Tape* x, const Tape* y) const { return *x < *y; }
+};
+
+// returns nanoseconds per key of sorting pointers to tapes of the keys
+template <typename Tape>
+double time_sort(const std::vector<std::vector<uint64_t> >& keys) {
+  std::vector<Tape> tapes;
+  tapes.reserve(keys.size());
+  for (size_t i = 0; i < keys.size(); ++i) {
+    tapes.push_back(Tape(begin(keys[i]), end(keys[i])));
+  }
+  std::vector<const Tape*> pointers(tapes.size());
+  for (size_t i = 0; i < tapes.size(); ++i) pointers[i] = &tapes[i];
+  timer tm;
+  tm.start();
+  std::sort(begin(pointers), end(pointers), less_by_pointer<Tape>());
+  return tm.stop() / double(keys.size());
+}
+
+void run_sort_test(const std::string& name, size_t n, size_t key_size, uint64_t range) {
+  zipf z(range);
+  std::vector<std::vector<uint64_t> > keys(n);
+  for (size_t i = 0; i < n; ++i) {
+    for (size_t j = 0; j < key_size; ++j) keys[i].push_back(z.random());
+  }
+  std::cout << std::setw(16) << name;
+  print_cell(time_sort<tape<vbyte_descriptor> >(keys), 1);
+  print_cell(time_sort<tape<ordered_integer_descriptor> >(keys), 1);
+  std::cout << std::endl;
+}
+
+// Moving: nanoseconds per tape of growing a vector of tapes by push_back
+// and of sorting the vector, with tapes that can only be copied (as before
+// they had move constructors) and with tapes that are moved
+
+template <typename Tape>
+struct copied_tape : Tape {
+  copied_tape() {}
+  template <typename Iterator>
+  copied_tape(Iterator first, Iterator last) : Tape(first, last) {}
+  copied_tape(const copied_tape& x) : Tape(x) {}
+  copied_tape& operator=(const copied_tape& x) {
+    Tape::operator=(x);
+    return *this;
+  }
+};
+
+template <typename Tape>
+std::pair<double, double> time_moving(const std::vector<std::vector<uint64_t> >& keys) {
+  std::vector<Tape> source;
+  source.reserve(keys.size());
+  for (size_t i = 0; i < keys.size(); ++i) source.push_back(Tape(begin(keys[i]), end(keys[i])));
+  timer tm;
+  tm.start();
+  std::vector<Tape> tapes;
+  for (size_t i = 0; i < source.size(); ++i) tapes.push_back(std::move(source[i]));
+  double grow = tm.stop();
+  tm.start();
+  std::sort(begin(tapes), end(tapes));
+  double sort = tm.stop();
+  return std::make_pair(grow / double(keys.size()), sort / double(keys.size()));
+}
+
+void run_moving_test(const std::string& name, size_t n, size_t key_size, uint64_t range) {
+  typedef tape<vbyte_descriptor> vbyte_tape;
+  zipf z(range);
+  std::vector<std::vector<uint64_t> > keys(n);
+  for (size_t i = 0; i < n; ++i) {
+    for (size_t j = 0; j < key_size; ++j) keys[i].push_back(z.random());
+  }
+  std::pair<double, double> copy_time = time_moving<copied_tape<vbyte_tape> >(keys);
+  std::pair<double, double> move_time = time_moving<vbyte_tape>(keys);
+  std::cout << std::setw(16) << name;
+  print_cell(copy_time.first, 1);
+  print_cell(move_time.first, 1);
+  print_cell(copy_time.second, 1);
+  print_cell(move_time.second, 1);
+  std::cout << std::endl;
+}
+
+// Copying: nanoseconds per tape of copying tapes into a cache, and of
+// then appending a value to every copy, with extent and shared_extent
+
+template <typename Tape>
+std::pair<double, double> time_copying(const std::vector<Tape>& tapes) {
+  timer tm;
+  tm.start();
+  std::vector<Tape> copies(tapes);
+  double copy = tm.stop();
+  tm.start();
+  for (size_t i = 0; i < copies.size(); ++i) copies[i].push_back(1);
+  double append = tm.stop();
+  return std::make_pair(copy / double(tapes.size()), append / double(tapes.size()));
+}
+
+void run_copying_test(const std::string& name, size_t n, size_t length) {
+  typedef tape<vbyte_descriptor> vbyte_tape;
+  typedef tape<vbyte_descriptor, malloc_allocator, doubling_growth, shared_extent> shared_tape;
+  std::vector<uint64_t> v = generate(length, zipf_gaps(1 << 16));
+  std::vector<vbyte_tape> tapes(n, vbyte_tape(begin(v), end(v)));
+  std::vector<shared_tape> shared_tapes;
+  for (size_t i = 0; i < n; ++i) shared_tapes.push_back(shared_tape(begin(v), end(v)));
+  std::pair<double, double> extent_time = time_copying(tapes);
+  std::pair<double, double> shared_time = time_copying(shared_tapes);
+  std::cout << std::setw(16) << name;
+  print_cell(extent_time.first, 1);
+  print_cell(extent_time.second, 1);
+  print_cell(shared_time.first, 1);
+  print_cell(shared_time.second, 1);
+  std::cout << std::endl;
+}
+
+// Doubles: bytes per value and nanoseconds per value of summing a gauge
+// series bulk decoded from a gorilla tape
+
+// a reading with two decimals that changes with the given probability
+std::vector<double> gauge(size_t n, double change_probability) {
+  std::vector<double> result;
+  double reading(20.0);
+  for (size_t i = 0; i < n; ++i) {
+    if (drand48() < change_probability) reading += double(lrand48() % 21 - 10) / 100.0;
+    result.push_back(reading);
+  }
+  return result;
+}
+
+void run_double_test(const std::string& name, const std::vector<double>& v,
+                     size_t iterations) {
+  tape<gorilla_descriptor> t;
+  append_blocks(t, begin(v), end(v));
+  std::cout << std::setw(16) << name;
+  print_cell(double(t.get_extent().byte_size()) / double(v.size()), 2);
+  print_cell(time_bulk_decode<double>(t, iterations), 2);
+  std::cout << std::endl;
+}
+
+const size_t size(16 * 1024 * 1024);
+const size_t iterations(4);
+
+int main() {
+  time_t now = time(0);
+  std::cout << "Decoding " << size << " encoded values at: "
+            << asctime(localtime(&now));
+  std::vector<const char*> names {
+    " bytes",
+    "  iter",
+    "  bulk",
+    " delta",
+    "svbyte",
+    "  bulk",
+    "gvrint",
+    "  bulk",
+    "  pfor",
+    "  bulk",
+    " adapt",
+    "  bulk"
+  };
+  std::cout << std::setw(16) << "distribution";
+  for (auto x: names) print_cell(x);
+  std::cout << std::endl;
+
+  run_decode_test("zipf 2^32", generate(size, zipf_gaps(std::numeric_limits<uint32_t>::max())), iterations);
+  run_decode_test("exponential 16", generate(size, exponential_gaps(16.0)), iterations);
+  run_decode_test("exponential 1K", generate(size, exponential_gaps(1024.0)), iterations);
+  run_decode_test("random 64 bit", generate(size, random_words()), iterations);
+
+  std::cout << std::endl << "Decoding " << size << " doubles" << std::endl;
+  std::cout << std::setw(16) << "series";
+  print_cell(" bytes");
+  print_cell("gorila");
+  std::cout << std::endl;
+  run_double_test("gauge 1/8", gauge(size, 0.125), iterations);
+  run_double_test("gauge 1/2", gauge(size, 0.5), iterations);
+  run_double_test("gauge 1/1", gauge(size, 1.0), iterations);
+
+  std::cout << std::endl << "Vbyte kernels for " << size << " zipf 2^32 values" << std::endl;
+  std::cout << std::setw(16) << "cpu level";
+  print_cell("  size");
+  print_cell("encode");
+  print_cell("decode");
+  std::cout << std::endl;
+  run_kernel_test(generate(size, zipf_gaps(std::numeric_limits<uint32_t>::max())), iterations);
+
+  std::cout << std::endl << "Transcoding " << size << " values from vbyte to ordered" << std::endl;
+  std::cout << std::setw(16) << "distribution";
+  print_cell("  push");
+  print_cell(" range");
+  print_cell("trans");
+  std::cout << std::endl;
+  run_transcode_test("zipf 2^32", generate(size, zipf_gaps(std::numeric_limits<uint32_t>::max())));
+  run_transcode_test("random 64 bit", generate(size, random_words()));
+
+  const size_t lists(1024 * 1024);
+  std::cout << std::endl << "Nesting " << lists << " lists" << std::endl;
+  std::cout << std::setw(16) << "list lengths";
+  print_cell(" bytes");
+  print_cell(" build");
+  print_cell("   sum");
+  print_cell("nested");
+  print_cell(" build");
+  print_cell("   sum");
+  std::cout << std::endl;
+  run_nesting_test("1 .. 4", lists, 2);
+  run_nesting_test("1 .. 32", lists, 16);
+
+  std::cout << std::endl << "Appending " << size << " gaps" << std::endl;
+  std::cout << std::setw(16) << "distribution";
+  print_cell("insert");
+  print_cell("append");
+  print_cell(" input");
+  std::cout << std::endl;
+  run_append_test("zipf 2^16", generate(size, zipf_gaps(1 << 16)));
+  run_append_test("exponential 1K", generate(size, exponential_gaps(1024.0)));
+
+  std::cout << std::endl << "Growing a tape of " << size << " values" << std::endl;
+  std::cout << std::setw(16) << "distribution";
+  print_cell("  copy");
+  print_cell("    2x");
+  print_cell("  1.5x");
+  print_cell(" exact");
+  std::cout << std::endl;
+  run_growth_test("zipf 2^32", generate(size, zipf_gaps(std::numeric_limits<uint32_t>::max())));
+  run_growth_test("random 64 bit", generate(size, random_words()));
+
+  std::cout << std::endl << "Logging " << size << " values" << std::endl;
+  std::cout << std::setw(16) << "distribution";
+  print_cell("  copy");
+  print_cell("decode");
+  print_cell("  tape");
+  print_cell("decode");
+  print_cell("  segm");
+  print_cell("decode");
+  std::cout << std::endl;
+  run_logging_test("zipf 2^32", generate(size, zipf_gaps(std::numeric_limits<uint32_t>::max())));
+  run_logging_test("random 64 bit", generate(size, random_words()));
+
+  const size_t patched(size / 16);
+  std::cout << std::endl << "Patching the middle of " << patched << " values" << std::endl;
+  std::cout << std::setw(16) << "inserted values";
+  print_cell("  tape");
+  print_cell("   gap");
+  std::cout << std::endl;
+  std::vector<uint64_t> patched_values = generate(patched, zipf_gaps(1 << 16));
+  run_patching_test("100", patched_values, 100);
+  run_patching_test("10000", patched_values, 10000);
+
+  std::cout << std::endl << "Allocating " << lists << " lists" << std::endl;
+  std::cout << std::setw(16) << "list lengths";
+  print_cell("malloc");
+  print_cell("  free");
+  print_cell("  pool");
+  print_cell("  free");
+  print_cell(" arena");
+  print_cell("  free");
+  std::cout << std::endl;
+  run_allocation_test("1 .. 4", lists, 2);
+  run_allocation_test("1 .. 32", lists, 16);
+
+  std::cout << std::endl << "Small tapes for " << lists << " lists" << std::endl;
+  std::cout << std::setw(16) << "list lengths";
+  print_cell(" bytes");
+  print_cell(" alloc");
+  print_cell(" build");
+  print_cell(" small");
+  print_cell(" alloc");
+  print_cell(" build");
+  std::cout << std::endl;
+  run_small_tape_test("1 .. 4", lists, 2);
+  run_small_tape_test("1 .. 32", lists, 16);
+
+  const size_t universe(1 << 24);
+  std::cout << std::endl << "Intersecting sets of documents below " << universe << std::endl;
+  std::cout << std::setw(16) << "densities";
+  print_cell(" bytes");
+  print_cell(" delta");
+  print_cell(" bytes");
+  print_cell("hybrid");
+  std::cout << std::endl;
+  run_intersection_test("1/2 x 1/2", universe, 0.5, 0.5, iterations);
+  run_intersection_test("1/2 x 1/64", universe, 0.5, 1.0 / 64, iterations);
+  run_intersection_test("1/64 x 1/64", universe, 1.0 / 64, 1.0 / 64, iterations);
+
+  const size_t keys(1024 * 1024);
+  std::cout << std::endl << "Sorting " << keys << " tapes" << std::endl;
+  std::cout << std::setw(16) << "keys";
+  print_cell(" vbyte");
+  print_cell(" order");
+  std::cout << std::endl;
+  run_sort_test("4 x zipf 2^8", keys, 4, 1 << 8);
+  run_sort_test("4 x zipf 2^32", keys, 4, std::numeric_limits<uint32_t>::max());
+  run_sort_test("16 x zipf 2^16", keys, 16, 1 << 16);
+
+  std::cout << std::endl << "Moving " << keys << " tapes" << std::endl;
+  std::cout << std::setw(16) << "keys";
+  print_cell("  grow");
+  print_cell("  move");
+  print_cell("  sort");
+  print_cell("  move");
+  std::cout << std::endl;
+  run_moving_test("4 x zipf 2^32", keys, 4, std::numeric_limits<uint32_t>::max());
+  run_moving_test("16 x zipf 2^16", keys, 16, 1 << 16);
+
+  std::cout << std::endl << "Copying tapes" << std::endl;
+  std::cout << std::setw(16) << "tapes x values";
+  print_cell("  copy");
+  print_cell("append");
+  print_cell("shared");
+  print_cell("append");
+  std::cout << std::endl;
+  run_copying_test("1M x 16", keys, 16);
+  run_copying_test("1K x 64K", keys / 1024, 64 * 1024);
+}
@@ -0,0 +1,233 @@
+#ifndef ADAPTIVE_DESCRIPTOR_H
+#define ADAPTIVE_DESCRIPTOR_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <iterator>
+#include <algorithm>
+#include <utility>
+
+// Only included for "concepts"
+#include "variable_size_type.h"
+
+#include "value_block.h"
+#include "vbyte_descriptor.h"
+#include "stream_vbyte_descriptor.h"
+#include "bit_packing.h"
+
+/*
+
+Chooses the encoding of every block of up to block_capacity values
+separately, so that a tape mixing dense runs of tiny gaps with sparse
+outliers gets the best encoding for each part:
+
+  bit packing  all values in b <= 32 bits; the smallest and fastest to
+               decode when the values have similar widths
+  raw          all values in w <= 8 little-endian bytes; for values of
+               similar large widths
+  vbyte        for blocks whose widths vary, such as Zipf-distributed
+               gaps: stream_vbyte_descriptor if all values fit in 32 bits,
+               since it decodes without a branch per byte, and
+               vbyte_descriptor otherwise
+
+The encoder computes the exact size of the block in every encoding and
+keeps the smallest, preferring bit packing and then raw on ties.  The
+datum records the choice in its second byte, the mode in the top two bits
+and its parameter in the low six:
+
+  count | 0x40 + b | count values of b bits
+  count | 0x80 + w | count values of w bytes
+  count | 0xc0     | stream VByte block
+  count | 0x00     | 2 bytes: the size of the data (little-endian) | vbyte data
+
+Decoding dispatches once per block.  Use it as tape<adaptive_descriptor>
+together with append_blocks and element_iterator from value_block.h.
+
+*/
+
+struct adaptive_descriptor {
+  enum { block_capacity = 128 };
+  typedef value_block<uint64_t, block_capacity> value_type;
+  enum { equality_preserving = true };
+  enum { order_preserving = false };
+  enum { prefixed_size = true };
+  typedef std::forward_iterator_tag iterator_category;
+
+  enum mode { vbyte_mode = 0x00, bit_packing_mode = 0x40, raw_mode = 0x80,
+              stream_vbyte_mode = 0xc0 };
+  enum { mode_mask = 0xc0, parameter_mask = 0x3f };
+
+  vbyte_descriptor vbyte;
+  stream_vbyte_descriptor stream_vbyte;
+
+  struct layout {
+    mode m;
+    unsigned parameter;
+    size_t data_size;
+  };
+
+  static
+  size_t header_size(mode m) { return m == vbyte_mode ? 4 : 2; }
+
+  layout best_layout(const value_type& x) const {
+    uint64_t all(0);
+    size_t vbyte_size(0);
+    size_t stream_vbyte_size(stream_vbyte_descriptor::control_size(x.count) + 1);
+    for (size_t i = 0; i < x.count; ++i) {
+      all |= x.values[i];
+      vbyte_size += vbyte.encoded_size(x.values[i]);
+      stream_vbyte_size += length_code(uint32_t(x.values[i])) + 1;
+    }
+    unsigned b = bit_width(all);
+    unsigned w = (b + 7) / 8;
+    layout result = { vbyte_mode, 0, vbyte_size };
+    size_t best = header_size(vbyte_mode) + vbyte_size;
+    if (b <= 32 && stream_vbyte_size + header_size(stream_vbyte_mode) <= best) {
+      layout stream = { stream_vbyte_mode, 0, stream_vbyte_size };
+      result = stream;
+      best = header_size(stream_vbyte_mode) + stream_vbyte_size;
+    }
+    if (x.count * w + header_size(raw_mode) <= best) {
+      layout raw = { raw_mode, w, x.count * w };
+      result = raw;
+      best = header_size(raw_mode) + raw.data_size;
+    }
+    if (b <= 32 && packed_size(x.count, b) + header_size(bit_packing_mode) <= best) {
+      layout packed = { bit_packing_mode, b, packed_size(x.count, b) };
+      result = packed;
+    }
+    return result;
+  }
+
+  size_t encoded_size(const value_type& x) const {
+    layout l = best_layout(x);
+    return header_size(l.m) + l.data_size;
+  }
+
+  uint8_t* encode(const value_type& x, uint8_t* dst) const {
+    layout l = best_layout(x);
+    *dst++ = uint8_t(x.count);
+    *dst++ = uint8_t(l.m | l.parameter);
+    switch (l.m) {
+    case bit_packing_mode: {
+      uint32_t values[block_capacity];
+      std::copy(x.begin(), x.end(), values);
+      return pack_bits(values, x.count, l.parameter, dst);
+    }
+    case stream_vbyte_mode:
+      return stream_vbyte.encode(stream_vbyte_descriptor::value_type(x.begin(), x.end()), dst);
+    case raw_mode:
+      for (size_t i = 0; i < x.count; ++i) {
+        for (size_t j = 0; j < l.parameter; ++j) *dst++ = uint8_t(x.values[i] >> (8 * j));
+      }
+      return dst;
+    default:
+      *dst++ = uint8_t(l.data_size);
+      *dst++ = uint8_t(l.data_size >> 8);
+      for (size_t i = 0; i < x.count; ++i) dst = vbyte.encode(x.values[i], dst);
+      return dst;
+    }
+  }
+
+  size_t size(const uint8_t* p) const {
+    size_t count = p[0];
+    unsigned parameter = p[1] & parameter_mask;
+    switch (p[1] & mode_mask) {
+    case bit_packing_mode:  return 2 + packed_size(count, parameter);
+    case raw_mode:          return 2 + count * parameter;
+    case stream_vbyte_mode: return 2 + stream_vbyte.size(p + 2);
+    default:                return 4 + (size_t(p[2]) | (size_t(p[3]) << 8));
+    }
+  }
+
+  // reads count values of w bytes at p into result
+  static
+  void decode_raw(const uint8_t* p, size_t count, unsigned w, uint64_t* result) {
+    uint64_t* result_last = result + count;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    // a masked word load while 8 bytes remain in the block
+    if (w) {
+      const uint64_t mask = ~uint64_t(0) >> (64 - 8 * w);
+      uint64_t* word_last = result + (count * w >= 8 ? (count * w - 8) / w + 1 : 0);
+      while (result != word_last) {
+        uint64_t word;
+        memcpy(&word, p, sizeof(word));
+        *result++ = word & mask;
+        p += w;
+      }
+    }
+#endif
+    while (result != result_last) {
+      uint64_t x(0);
+      for (size_t j = w; j != 0; --j) x = (x << 8) | p[j - 1];
+      *result++ = x;
+      p += w;
+    }
+  }
+
+  // decodes the block at p into result and returns the number of values
+  size_t decode_values(const uint8_t* p, uint64_t* result) const {
+    size_t count = p[0];
+    unsigned parameter = p[1] & parameter_mask;
+    switch (p[1] & mode_mask) {
+    case bit_packing_mode: {
+      uint32_t values[block_capacity];
+      unpack_bits(p + 2, count, parameter, values);
+      std::copy(values, values + count, result);
+      break;
+    }
+    case raw_mode:
+      decode_raw(p + 2, count, parameter, result);
+      break;
+    case stream_vbyte_mode: {
+      uint32_t values[block_capacity];
+      stream_vbyte.decode_values(p + 2, values);
+      std::copy(values, values + count, result);
+      break;
+    }
+    default: {
+      const uint8_t* first = p + 4;
+      const uint8_t* last = first + (size_t(p[2]) | (size_t(p[3]) << 8));
+      decode_n(first, last, count, result, vbyte);
+    }
+    }
+    return count;
+  }
+
+  value_type decode(const uint8_t* p) const {
+    value_type result;
+    result.count = decode_values(p, result.values);
+    return result;
+  }
+
+  std::pair<const uint8_t*, uint8_t*>
+  copy(const uint8_t* src, uint8_t* dst) const {
+    size_t n = size(src);
+    memcpy(dst, src, n);
+    return std::make_pair(src + n, dst + n);
+  }
+};
+
+// decodes the values of the blocks in the well-formed range [first, last)
+// into result, stopping before the first block that does not fit in n
+// values; returns the positions following the last read and written values
+inline
+std::pair<const uint8_t*, uint64_t*>
+decode_n(const uint8_t* first, const uint8_t* last, size_t n,
+         uint64_t* result,
+         const adaptive_descriptor& dsc) {
+  uint64_t* result_last = result + n;
+  while (first != last && size_t(result_last - result) >= *first) {
+    result += dsc.decode_values(first, result);
+    first += dsc.size(first);
+  }
+  return std::make_pair(first, result);
+}
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 2
+// indent-tabs-mode: nil
+// End:
+#endif
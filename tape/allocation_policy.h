@@ -0,0 +1,277 @@
+#ifndef ALLOCATION_POLICY_H
+#define ALLOCATION_POLICY_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
+#include <new>
+
+// Only included for "concepts"
+#include "extent.h"
+
+/*
+
+Allocation policies for extent (and so for tape) besides malloc_allocator.
+An extent keeps only one pointer, so a policy cannot be stored in it: the
+policies here are stateless types whose static member functions forward
+to an allocator chosen outside of the extent.
+
+arena is a bump allocator.  It takes blocks of block_size bytes (or
+larger, for larger requests) from malloc and hands them out in order;
+deallocate does nothing, and release frees all the blocks at once, so a
+segment of an index built of millions of small tapes is freed without
+visiting the tapes.  The last allocation of the arena is resized in
+place, but the old extents of the other tapes are not reused, so tapes
+built one value at a time side by side use up to twice their final
+capacity; constructing a tape from a forward range allocates once.
+
+arena_allocator<Tag> allocates from the current arena of Tag, set for a
+scope with arena_scope.  The tapes allocated in an arena must not be
+modified or read after it is released; they can still be destroyed.
+
+size_class_pool rounds every request up to a power of two between
+min_class_size and max_class_size and keeps a free list per class,
+carving slabs of slab_size bytes; larger requests go to malloc.  A
+block is resized in place while it stays in its class.  The
+slabs are freed when the pool is destroyed.  pool_allocator<Tag> uses
+one pool per Tag, which is never destroyed.
+
+None of them is thread-safe: use a different Tag per thread.
+
+*/
+
+class arena {
+private:
+  struct block {
+    block* next;
+    size_t size;
+  };
+
+  enum { alignment = 16 };
+
+  block* blocks;
+  uint8_t* top;
+  uint8_t* limit;
+  size_t block_size;
+  size_t allocated;
+
+  static
+  size_t align(size_t n) { return (n + (alignment - 1)) & ~size_t(alignment - 1); }
+
+  // not copyable
+  arena(const arena&);
+  arena& operator=(const arena&);
+
+  void new_block(size_t n) {
+    size_t size = n > block_size ? n : block_size;
+    size_t header_size = align(sizeof(block));
+    block* b = (block*)malloc(header_size + size);
+    if (b == NULL) throw std::bad_alloc();
+    b->next = blocks;
+    b->size = header_size + size;
+    blocks = b;
+    allocated += b->size;
+    top = (uint8_t*)b + header_size;
+    limit = top + size;
+  }
+
+public:
+  arena(size_t block_size = 1024 * 1024)
+    : blocks(NULL), top(NULL), limit(NULL), block_size(block_size), allocated(0) {}
+
+  ~arena() { release(); }
+
+  void* allocate(size_t n) {
+    n = align(n);
+    if (size_t(limit - top) < n) new_block(n);
+    void* result = top;
+    top += n;
+    return result;
+  }
+
+  void deallocate(void*, size_t) {}
+
+  // resizes in place the last allocation, or any allocation to a smaller
+  // size; returns NULL otherwise
+  void* reallocate(void* p, size_t n, size_t m) {
+    uint8_t* q = (uint8_t*)p;
+    if (q + align(n) == top) {
+      if (size_t(limit - q) < align(m)) return NULL;
+      top = q + align(m);
+      return p;
+    }
+    return m <= n ? p : NULL;
+  }
+
+  // frees all the memory allocated in the arena
+  void release() {
+    while (blocks) {
+      block* next = blocks->next;
+      free(blocks);
+      blocks = next;
+    }
+    top = limit = NULL;
+    allocated = 0;
+  }
+
+  // returns the number of bytes taken from malloc
+  size_t byte_size() const { return allocated; }
+};
+
+
+template <typename Tag = void>
+struct arena_allocator {
+  static
+  arena*& current_arena() {
+    static arena* current = NULL;
+    return current;
+  }
+
+  static
+  void* allocate(size_t n) {
+    if (current_arena() == NULL) throw std::bad_alloc();
+    return current_arena()->allocate(n);
+  }
+
+  static
+  void deallocate(void*, size_t) {}
+
+  static
+  void* reallocate(void* p, size_t n, size_t m) {
+    if (current_arena() == NULL) return NULL;
+    return current_arena()->reallocate(p, n, m);
+  }
+};
+
+// makes x the current arena of Tag until the end of the scope
+
+template <typename Tag = void>
+class arena_scope {
+private:
+  arena* previous;
+
+  arena_scope(const arena_scope&);
+  arena_scope& operator=(const arena_scope&);
+
+public:
+  arena_scope(arena& x) : previous(arena_allocator<Tag>::current_arena()) {
+    arena_allocator<Tag>::current_arena() = &x;
+  }
+
+  ~arena_scope() { arena_allocator<Tag>::current_arena() = previous; }
+};
+
+
+class size_class_pool {
+public:
+  enum { min_class_size = 32, max_class_size = 4096, number_of_classes = 8 };
+  enum { slab_size = 64 * 1024, slab_header_size = 16 };
+
+private:
+  struct free_block {
+    free_block* next;
+  };
+
+  free_block* free_lists[number_of_classes];
+  free_block* slabs;
+
+  size_class_pool(const size_class_pool&);
+  size_class_pool& operator=(const size_class_pool&);
+
+  // returns the index of the smallest class holding n <= max_class_size bytes
+  static
+  size_t size_class(size_t n) {
+    size_t i = 0;
+    size_t class_size = min_class_size;
+    while (class_size < n) {
+      class_size *= 2;
+      ++i;
+    }
+    return i;
+  }
+
+  static
+  size_t class_size(size_t i) { return size_t(min_class_size) << i; }
+
+  void refill(size_t i) {
+    // the header of a slab links the slabs together
+    uint8_t* slab = (uint8_t*)malloc(slab_size);
+    if (slab == NULL) throw std::bad_alloc();
+    ((free_block*)slab)->next = slabs;
+    slabs = (free_block*)slab;
+    size_t size = class_size(i);
+    for (uint8_t* p = slab + slab_header_size; p + size <= slab + slab_size; p += size) {
+      free_block* b = (free_block*)p;
+      b->next = free_lists[i];
+      free_lists[i] = b;
+    }
+  }
+
+public:
+  size_class_pool() : slabs(NULL) {
+    for (size_t i = 0; i < number_of_classes; ++i) free_lists[i] = NULL;
+  }
+
+  ~size_class_pool() {
+    while (slabs) {
+      free_block* next = slabs->next;
+      free(slabs);
+      slabs = next;
+    }
+  }
+
+  void* allocate(size_t n) {
+    if (n > max_class_size) return malloc_allocator::allocate(n);
+    size_t i = size_class(n);
+    if (free_lists[i] == NULL) refill(i);
+    free_block* b = free_lists[i];
+    free_lists[i] = b->next;
+    return b;
+  }
+
+  void deallocate(void* p, size_t n) {
+    if (n > max_class_size) {
+      malloc_allocator::deallocate(p, n);
+      return;
+    }
+    size_t i = size_class(n);
+    free_block* b = (free_block*)p;
+    b->next = free_lists[i];
+    free_lists[i] = b;
+  }
+
+  // resizes in place within a class, or with realloc above the classes;
+  // returns NULL otherwise
+  void* reallocate(void* p, size_t n, size_t m) {
+    if (n > max_class_size) return m > max_class_size ? realloc(p, m) : NULL;
+    if (m > max_class_size) return NULL;
+    return size_class(n) == size_class(m) ? p : NULL;
+  }
+};
+
+
+template <typename Tag = void>
+struct pool_allocator {
+  static
+  size_class_pool& pool() {
+    // never destroyed, so that it outlives tapes with static storage duration
+    static size_class_pool* p = new size_class_pool;
+    return *p;
+  }
+
+  static
+  void* allocate(size_t n) { return pool().allocate(n); }
+
+  static
+  void deallocate(void* p, size_t n) { pool().deallocate(p, n); }
+
+  static
+  void* reallocate(void* p, size_t n, size_t m) { return pool().reallocate(p, n, m); }
+};
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 2
+// indent-tabs-mode: nil
+// End:
+#endif
@@ -0,0 +1,130 @@
+#ifndef BIT_PACKING_H
+#define BIT_PACKING_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+/*
+
+Packing of n unsigned values of at most 32 bits into ceil(n * b / 8)
+bytes, b bits per value, least significant bits first.
+
+The kernels are templates on the width, so that for every width the
+compiler sees a loop with constant shifts and masks which it can unroll
+and vectorize; pack_bits and unpack_bits dispatch on the width at run time.
+
+*/
+
+// returns the number of bits needed to represent x
+inline
+unsigned bit_width(uint64_t x) {
+  return x ? 64 - unsigned(__builtin_clzll(x)) : 0;
+}
+
+inline
+size_t packed_size(size_t n, unsigned b) {
+  return (n * b + 7) / 8;
+}
+
+template <unsigned B>
+uint8_t* pack_bits_fixed(const uint32_t* first, size_t n, uint8_t* dst) {
+  const uint64_t mask = (uint64_t(1) << B) - 1;
+  uint64_t buffer(0);
+  unsigned bits(0);
+  for (size_t i = 0; i < n; ++i) {
+    buffer |= (first[i] & mask) << bits;
+    bits += B;
+    while (bits >= 8) {
+      *dst++ = uint8_t(buffer);
+      buffer >>= 8;
+      bits -= 8;
+    }
+  }
+  if (bits) *dst++ = uint8_t(buffer);
+  return dst;
+}
+
+template <unsigned B>
+const uint8_t* unpack_bits_fixed(const uint8_t* src, size_t n, uint32_t* result) {
+  const uint64_t mask = (uint64_t(1) << B) - 1;
+  const uint8_t* last = src + packed_size(n, B);
+  uint32_t* result_last = result + n;
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  // 8 values take exactly B bytes; every value is extracted from a word
+  // load at a constant offset, which may read up to 8 bytes past the group
+  while (size_t(last - src) >= B + 8) {
+    for (unsigned j = 0; j < 8; ++j) {
+      uint64_t word;
+      memcpy(&word, src + (j * B) / 8, sizeof(word));
+      result[j] = uint32_t((word >> ((j * B) % 8)) & mask);
+    }
+    src += B;
+    result += 8;
+  }
+#endif
+  uint64_t buffer(0);
+  unsigned bits(0);
+  while (result != result_last) {
+    while (bits < B) {
+      buffer |= uint64_t(*src++) << bits;
+      bits += 8;
+    }
+    *result++ = uint32_t(buffer & mask);
+    buffer >>= B;
+    bits -= B;
+  }
+  return last;
+}
+
+template <>
+inline
+uint8_t* pack_bits_fixed<0>(const uint32_t*, size_t, uint8_t* dst) {
+  return dst;
+}
+
+template <>
+inline
+const uint8_t* unpack_bits_fixed<0>(const uint8_t* src, size_t n, uint32_t* result) {
+  for (size_t i = 0; i < n; ++i) result[i] = 0;
+  return src;
+}
+
+#define BIT_PACKING_CASES(F) \
+  F(0)  F(1)  F(2)  F(3)  F(4)  F(5)  F(6)  F(7)  F(8)  \
+  F(9)  F(10) F(11) F(12) F(13) F(14) F(15) F(16) \
+  F(17) F(18) F(19) F(20) F(21) F(22) F(23) F(24) \
+  F(25) F(26) F(27) F(28) F(29) F(30) F(31) F(32)
+
+// packs the low b <= 32 bits of the n values at first into dst and
+// returns the position following the packed bytes
+inline
+uint8_t* pack_bits(const uint32_t* first, size_t n, unsigned b, uint8_t* dst) {
+  switch (b) {
+#define BIT_PACKING_CASE(B) case B: return pack_bits_fixed<B>(first, n, dst);
+    BIT_PACKING_CASES(BIT_PACKING_CASE)
+#undef BIT_PACKING_CASE
+  }
+  return dst;
+}
+
+// unpacks n values of b <= 32 bits from src into result and returns the
+// position following the packed bytes
+inline
+const uint8_t* unpack_bits(const uint8_t* src, size_t n, unsigned b, uint32_t* result) {
+  switch (b) {
+#define BIT_PACKING_CASE(B) case B: return unpack_bits_fixed<B>(src, n, result);
+    BIT_PACKING_CASES(BIT_PACKING_CASE)
+#undef BIT_PACKING_CASE
+  }
+  return src;
+}
+
+#undef BIT_PACKING_CASES
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 2
+// indent-tabs-mode: nil
+// End:
+#endif
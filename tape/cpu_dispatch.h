@@ -0,0 +1,133 @@
+#ifndef CPU_DISPATCH_H
+#define CPU_DISPATCH_H
+
+/*
+
+The SIMD kernels of the descriptors used to be selected by the compiler
+flags (#ifdef __SSSE3__), so a binary built for generic x86-64 never used
+them and a binary built with -march=native did not run on older machines.
+With GCC and clang on x86 every kernel is now compiled for its own target
+with the target attribute, and the bulk functions (decode_n,
+total_encoded_size, encode_range) choose among them by the level of the CPU
+they run on, detected once with cpuid:
+
+  scalar_cpu   the baseline (on x86-64, SSE2)
+  sse41_cpu    SSSE3, SSE4.1 and POPCNT: the shuffle kernels
+  avx2_cpu     AVX2, BMI1, BMI2 and LZCNT: adds the pdep encoder and the
+               vectorized size computation
+  avx512_cpu   AVX-512 F, CD, BW and VL: adds the vplzcnt size computation
+
+The level is checked once per call of a bulk function, not once per
+value.  set_cpu_level lowers the level, so that tests and benchmarks can
+compare the kernels of every level on the same machine.
+
+Elsewhere, or when TAPE_NO_CPU_DISPATCH is defined, the TAPE_TARGET
+macros are empty, only the kernels allowed by the compiler flags are
+compiled and the detected level is derived from the same flags, as before.
+
+*/
+
+enum cpu_level { scalar_cpu, sse41_cpu, avx2_cpu, avx512_cpu };
+
+#if !defined(TAPE_NO_CPU_DISPATCH) && \
+    defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)) && \
+    (defined(__clang__) || __GNUC__ > 4 || (__GNUC__ == 4 && __GNUC_MINOR__ >= 9))
+#define TAPE_CPU_DISPATCH
+#endif
+
+#ifdef TAPE_CPU_DISPATCH
+
+#include <cpuid.h>
+
+#define TAPE_TARGET_SSE41 __attribute__((target("ssse3,sse4.1,popcnt")))
+#define TAPE_TARGET_AVX2 \
+  __attribute__((target("ssse3,sse4.1,popcnt,avx,avx2,bmi,bmi2,lzcnt")))
+#define TAPE_TARGET_AVX512 \
+  __attribute__((target("ssse3,sse4.1,popcnt,avx,avx2,bmi,bmi2,lzcnt,avx512f,avx512cd,avx512bw,avx512vl")))
+
+// LZCNT (ABM on AMD) is not among the features of __builtin_cpu_supports
+// of every supported compiler; without it, lzcnt runs as bsr and gives
+// wrong results instead of faulting
+inline
+bool cpu_supports_lzcnt() {
+  unsigned int eax, ebx, ecx, edx;
+  return __get_cpuid(0x80000001, &eax, &ebx, &ecx, &edx) && (ecx & (1u << 5)) != 0;
+}
+
+inline
+cpu_level detect_cpu_level() {
+  __builtin_cpu_init();
+  if (!(__builtin_cpu_supports("ssse3") && __builtin_cpu_supports("sse4.1") &&
+        __builtin_cpu_supports("popcnt"))) return scalar_cpu;
+  if (!(__builtin_cpu_supports("avx2") && __builtin_cpu_supports("bmi") &&
+        __builtin_cpu_supports("bmi2") && cpu_supports_lzcnt())) return sse41_cpu;
+  if (!(__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512cd") &&
+        __builtin_cpu_supports("avx512bw") && __builtin_cpu_supports("avx512vl"))) return avx2_cpu;
+  return avx512_cpu;
+}
+
+#else
+
+#define TAPE_TARGET_SSE41
+#define TAPE_TARGET_AVX2
+#define TAPE_TARGET_AVX512
+
+inline
+cpu_level detect_cpu_level() {
+#if defined(__AVX512F__) && defined(__AVX512CD__) && defined(__AVX512BW__) && defined(__AVX512VL__)
+  return avx512_cpu;
+#elif defined(__AVX2__) && defined(__BMI__) && defined(__BMI2__)
+  return avx2_cpu;
+#elif defined(__SSSE3__)
+  return sse41_cpu;
+#else
+  return scalar_cpu;
+#endif
+}
+
+#endif
+
+// the kernels of a level are compiled when they can be selected
+
+#if defined(TAPE_CPU_DISPATCH) || defined(__SSSE3__)
+#define TAPE_SSE41_KERNELS
+#endif
+
+#if defined(TAPE_CPU_DISPATCH) || (defined(__AVX2__) && defined(__BMI__) && defined(__BMI2__))
+#define TAPE_AVX2_KERNELS
+#endif
+
+#if defined(TAPE_CPU_DISPATCH) || \
+    (defined(__AVX512F__) && defined(__AVX512CD__) && defined(__AVX512BW__) && defined(__AVX512VL__))
+#define TAPE_AVX512_KERNELS
+#endif
+
+#if defined(TAPE_SSE41_KERNELS)
+#include <immintrin.h>
+#endif
+
+// the level of the kernels in use
+inline
+cpu_level& selected_cpu_level() {
+  static cpu_level level = detect_cpu_level();
+  return level;
+}
+
+inline
+cpu_level current_cpu_level() { return selected_cpu_level(); }
+
+// selects the kernels of level x, or of the detected level if it is lower;
+// returns the level selected
+inline
+cpu_level set_cpu_level(cpu_level x) {
+  cpu_level detected = detect_cpu_level();
+  selected_cpu_level() = x < detected ? x : detected;
+  return selected_cpu_level();
+}
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 2
+// indent-tabs-mode: nil
+// End:
+#endif
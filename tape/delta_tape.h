@@ -0,0 +1,311 @@
+#ifndef DELTA_TAPE_H
+#define DELTA_TAPE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <iterator>
+#include <algorithm>
+#include <utility>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+#include "iterator_adapter.h"
+#include "variable_size_type.h"
+#include "tape.h"
+
+/*
+
+delta_tape stores a non-decreasing sequence of unsigned integers as a tape
+of the gaps between consecutive values (the first gap being the first
+value), and gives back the values themselves.  It replaces the pattern of
+accumulate.cpp,
+
+  std::adjacent_difference(first, last, std::back_inserter(gaps));
+  ... accumulate_iterator<tape::iterator>(gaps.begin()) ...
+
+whose iterators have to be dereferenced before they are incremented and
+cannot go backward.  Here an iterator keeps the position of the next gap
+together with the value preceding it, so dereferencing is optional,
+iterators compare by position, and with a bidirectional descriptor they go
+backward by subtracting the gap before them.  The tape also keeps its last
+value, so that end() can be decremented.
+
+For bulk decoding delta_decode_n decodes the gaps with decode_n (using the
+kernels of the descriptor) and then turns them into values with a
+vectorized prefix sum.
+
+*/
+
+// replaces the values of [first, last) with their running sums starting
+// from base and returns the last sum (or base if the range is empty)
+
+template <typename T>
+T prefix_sum(T* first, T* last, T base) {
+  while (first != last) {
+    base += *first;
+    *first++ = base;
+  }
+  return base;
+}
+
+#ifdef __SSE2__
+
+// Four lanes are summed in two shift-and-add steps and then offset by the
+// carry, the last sum broadcast from the previous quad (Lemire, Boytsov,
+// Kurz, "SIMD Compression and the Intersection of Sorted Integers").
+
+inline
+uint32_t prefix_sum(uint32_t* first, uint32_t* last, uint32_t base) {
+  __m128i carry = _mm_set1_epi32(int(base));
+  while (last - first >= 4) {
+    __m128i x = _mm_loadu_si128((const __m128i*)first);
+    x = _mm_add_epi32(x, _mm_slli_si128(x, 4));
+    x = _mm_add_epi32(x, _mm_slli_si128(x, 8));
+    x = _mm_add_epi32(x, carry);
+    _mm_storeu_si128((__m128i*)first, x);
+    carry = _mm_shuffle_epi32(x, _MM_SHUFFLE(3, 3, 3, 3));
+    first += 4;
+  }
+  return prefix_sum<uint32_t>(first, last, uint32_t(_mm_cvtsi128_si32(carry)));
+}
+
+inline
+uint64_t prefix_sum(uint64_t* first, uint64_t* last, uint64_t base) {
+  // two pairs per iteration, so that the carry chain is two additions
+  // and one shuffle for four values
+  __m128i carry = _mm_set1_epi64x(int64_t(base));
+  while (last - first >= 4) {
+    __m128i x = _mm_loadu_si128((const __m128i*)first);
+    __m128i y = _mm_loadu_si128((const __m128i*)(first + 2));
+    x = _mm_add_epi64(x, _mm_slli_si128(x, 8));
+    y = _mm_add_epi64(y, _mm_slli_si128(y, 8));
+    y = _mm_add_epi64(y, _mm_shuffle_epi32(x, _MM_SHUFFLE(3, 2, 3, 2)));
+    x = _mm_add_epi64(x, carry);
+    y = _mm_add_epi64(y, carry);
+    _mm_storeu_si128((__m128i*)first, x);
+    _mm_storeu_si128((__m128i*)(first + 2), y);
+    carry = _mm_shuffle_epi32(y, _MM_SHUFFLE(3, 2, 3, 2));
+    first += 4;
+  }
+  uint64_t sum;
+  _mm_storel_epi64((__m128i*)&sum, carry);
+  return prefix_sum<uint64_t>(first, last, sum);
+}
+
+#endif
+
+// decodes at most n gaps from the well-formed range [first, last) and
+// writes the values they lead to from base into result; returns the
+// positions following the last read and written values.  To resume,
+// pass the last written value as base.
+
+template <typename T, typename VariableSizeTypeDescriptor>
+std::pair<const uint8_t*, T*>
+delta_decode_n(const uint8_t* first, const uint8_t* last, size_t n,
+               T* result, T base,
+               const VariableSizeTypeDescriptor& dsc) {
+  std::pair<const uint8_t*, T*> p = decode_n(first, last, n, result, dsc);
+  prefix_sum(result, p.second, base);
+  return p;
+}
+
+
+// the gaps of a non-decreasing ForwardIterator range, used to insert them
+// into a tape without an intermediate buffer
+
+template <typename ForwardIterator>
+struct gap_iterator_basis {
+  typedef std::forward_iterator_tag iterator_category;
+  typedef typename std::iterator_traits<ForwardIterator>::value_type value_type;
+  typedef ptrdiff_t difference_type;
+  typedef value_type reference;
+  typedef void pointer;
+  typedef ForwardIterator state_type;
+
+  ForwardIterator position;
+  value_type previous;
+
+  gap_iterator_basis() : previous(0) {}
+  gap_iterator_basis(ForwardIterator position, value_type previous)
+    : position(position), previous(previous) {}
+
+  const state_type& state() const { return position; }
+
+  reference deref() const { return *position - previous; }
+
+  void increment() {
+    previous = *position;
+    ++position;
+  }
+};
+
+
+template <typename WritableVariableSizeTypeDescriptor>
+class delta_tape {
+public:
+  typedef WritableVariableSizeTypeDescriptor descriptor_type;
+  typedef tape<descriptor_type> gap_tape;
+  typedef typename descriptor_type::value_type value_type;
+  typedef value_type reference;
+  typedef value_type const_reference;
+  typedef size_t size_type;
+
+  struct iterator_basis {
+    typedef typename gap_tape::const_iterator gap_iterator;
+    typedef typename gap_iterator::iterator_category iterator_category;
+    typedef typename delta_tape::value_type value_type;
+    typedef typename gap_iterator::difference_type difference_type;
+    typedef value_type reference;
+    typedef void pointer;
+    typedef gap_iterator state_type;
+
+    gap_iterator position;  // of the gap leading to the current value
+    value_type previous;    // the value before the current one
+
+    iterator_basis() : previous(0) {}
+    iterator_basis(gap_iterator position, value_type previous)
+      : position(position), previous(previous) {}
+
+    const state_type& state() const { return position; }
+
+    reference deref() const { return previous + *position; }
+
+    void increment() {
+      previous += *position;
+      ++position;
+    }
+
+    // requires a bidirectional descriptor
+    void decrement() {
+      --position;
+      previous -= *position;
+    }
+  };
+
+  typedef adapter::iterator<iterator_basis> const_iterator;
+  typedef const_iterator iterator;
+  typedef typename const_iterator::difference_type difference_type;
+
+private:
+  gap_tape gaps;
+  value_type last_value;
+
+public:
+  const gap_tape& get_gaps() const { return gaps; }
+
+  bool empty() const { return gaps.empty(); }
+
+  size_type size() const { return gaps.size(); }
+
+  descriptor_type descriptor() const { return gaps.descriptor(); }
+
+  const_iterator begin() const {
+    return const_iterator(iterator_basis(gaps.begin(), value_type(0)));
+  }
+
+  const_iterator end() const {
+    return const_iterator(iterator_basis(gaps.end(), last_value));
+  }
+
+  // requires !empty()
+  value_type back() const { return last_value; }
+
+  // requires empty() || back() <= v
+  void push_back(const value_type& v) {
+    gaps.push_back(v - last_value);
+    last_value = v;
+  }
+
+private:
+  template <typename InputIterator>
+  void append(InputIterator first, InputIterator last, std::input_iterator_tag) {
+    while (first != last) push_back(*first++);
+  }
+
+  template <typename ForwardIterator>
+  void append(ForwardIterator first, ForwardIterator last, std::forward_iterator_tag) {
+    if (first == last) return;
+    typedef adapter::iterator<gap_iterator_basis<ForwardIterator> > gap_iterator;
+    gaps.insert(gaps.end(),
+                gap_iterator(gap_iterator_basis<ForwardIterator>(first, last_value)),
+                gap_iterator(gap_iterator_basis<ForwardIterator>(last, value_type(0))));
+    ForwardIterator i = first;
+    while (++first != last) i = first;
+    last_value = *i;
+  }
+
+public:
+  // appends the values of [first, last);
+  // requires [first, last) to be non-decreasing and not to start below back()
+  template <typename InputIterator>
+  void append(InputIterator first, InputIterator last) {
+    typename std::iterator_traits<InputIterator>::iterator_category tag;
+    append(first, last, tag);
+  }
+
+  // decodes all the values into result, which must have room for size()
+  // values, and returns the position following the last written value
+  template <typename T>
+  T* copy_values(T* result) const {
+    const uint8_t* first = gaps.get_extent().storage();
+    const uint8_t* last = gaps.get_extent().content_end();
+    return delta_decode_n(first, last, size(), result, T(0), descriptor()).second;
+  }
+
+  delta_tape(const descriptor_type& dsc = descriptor_type())
+    : gaps(dsc), last_value(0) {}
+
+  // requires [first, last) to be non-decreasing
+  template <typename InputIterator>
+  delta_tape(InputIterator first, InputIterator last,
+             const descriptor_type& dsc = descriptor_type())
+    : gaps(dsc), last_value(0) {
+    append(first, last);
+  }
+
+  // equal values have equal gaps
+  friend
+  bool operator==(const delta_tape& x, const delta_tape& y) {
+    return x.gaps == y.gaps;
+  }
+
+  friend
+  bool operator!=(const delta_tape& x, const delta_tape& y) {
+    return !(x == y);
+  }
+
+  friend
+  bool operator<(const delta_tape& x, const delta_tape& y) {
+    return std::lexicographical_compare(x.begin(), x.end(), y.begin(), y.end());
+  }
+
+  friend
+  bool operator>(const delta_tape& x, const delta_tape& y) {
+    return y < x;
+  }
+
+  friend
+  bool operator<=(const delta_tape& x, const delta_tape& y) {
+    return !(y < x);
+  }
+
+  friend
+  bool operator>=(const delta_tape& x, const delta_tape& y) {
+    return !(x < y);
+  }
+
+  friend
+  void swap(delta_tape& x, delta_tape& y) {
+    swap(x.gaps, y.gaps);
+    std::swap(x.last_value, y.last_value);
+  }
+};
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 2
+// indent-tabs-mode: nil
+// End:
+#endif
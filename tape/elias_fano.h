@@ -0,0 +1,278 @@
+#ifndef ELIAS_FANO_H
+#define ELIAS_FANO_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <iterator>
+#include <vector>
+#include <algorithm>
+
+#ifdef __BMI2__
+#include <immintrin.h>
+#endif
+
+#include "iterator_adapter.h"
+
+/*
+
+Elias-Fano representation of a non-decreasing sequence of n values
+smaller than u (Elias 1974, Fano 1971; Vigna, WSDM 2013).
+
+Every value is split into its low l = floor(log2(u / n)) bits, stored
+verbatim in a packed array, and its high bits h, stored in unary in a
+bitvector: the i-th value sets bit h + i.  The sequence takes at most
+2 + ceil(log2(u / n)) bits per value, close to the information
+theoretic minimum, and unlike a delta-encoded tape it allows
+
+  access(i)    - the i-th value: the position of the i-th one in the
+                 high bits minus i gives h
+  next_geq(x)  - the first value not less than x: the position of the
+                 (x >> l)-th zero tells where the values with high part
+                 x >> l start
+
+Both positions are found with select, which uses a sample of every
+select_sample-th one (zero) and then scans words with popcount.
+
+Compared to tape<vbyte_descriptor> with accumulate_iterator (see
+accumulate.cpp) the sequence is static: it is built once from a range.
+
+*/
+
+// returns the position of the k-th (counting from 0) set bit of x;
+// requires k < popcount(x)
+inline
+unsigned select_in_word(uint64_t x, unsigned k) {
+#ifdef __BMI2__
+  return unsigned(__builtin_ctzll(_pdep_u64(uint64_t(1) << k, x)));
+#else
+  while (k--) x &= x - 1;
+  return unsigned(__builtin_ctzll(x));
+#endif
+}
+
+class elias_fano_sequence {
+public:
+  typedef uint64_t value_type;
+  typedef size_t size_type;
+
+private:
+  enum { select_sample = 256 };
+
+  size_t n;
+  unsigned l;
+  std::vector<uint64_t> low;
+  std::vector<uint64_t> high;
+  size_t high_bits;
+  std::vector<size_t> one_samples;   // position of every select_sample-th one
+  std::vector<size_t> zero_samples;  // position of every select_sample-th zero
+
+  static bool bit(const std::vector<uint64_t>& v, size_t i) {
+    return (v[i / 64] >> (i % 64)) & 1;
+  }
+
+  uint64_t low_bits(size_t i) const {
+    if (!l) return 0;
+    size_t position = i * l;
+    size_t word = position / 64;
+    unsigned shift = position % 64;
+    uint64_t result = low[word] >> shift;
+    if (shift + l > 64) result |= low[word + 1] << (64 - shift);
+    return result & ((uint64_t(1) << l) - 1);
+  }
+
+  void set_low_bits(size_t i, uint64_t x) {
+    if (!l) return;
+    size_t position = i * l;
+    size_t word = position / 64;
+    unsigned shift = position % 64;
+    low[word] |= x << shift;
+    if (shift + l > 64) low[word + 1] |= x >> (64 - shift);
+  }
+
+  // returns the position of the k-th one (zero if Zeros) in the high bits,
+  // scanning from the sampled position
+  template <bool Zeros>
+  size_t select(const std::vector<size_t>& samples, size_t k) const {
+    size_t position = samples[k / select_sample];
+    k %= select_sample;
+    size_t word = position / 64;
+    uint64_t w = Zeros ? ~high[word] : high[word];
+    w &= ~uint64_t(0) << (position % 64);
+    size_t count = size_t(__builtin_popcountll(w));
+    while (count <= k) {
+      k -= count;
+      w = Zeros ? ~high[++word] : high[++word];
+      count = size_t(__builtin_popcountll(w));
+    }
+    return word * 64 + select_in_word(w, unsigned(k));
+  }
+
+  size_t next_one(size_t position) const {
+    size_t word = position / 64;
+    uint64_t w = high[word] & (~uint64_t(0) << (position % 64));
+    while (!w) w = high[++word];
+    return word * 64 + size_t(__builtin_ctzll(w));
+  }
+
+  size_t previous_one(size_t position) const { // requires a one before position
+    size_t word = (position - 1) / 64;
+    unsigned shift = (position - 1) % 64;
+    uint64_t w = high[word] & (~uint64_t(0) >> (63 - shift));
+    while (!w) w = high[--word];
+    return word * 64 + 63 - size_t(__builtin_clzll(w));
+  }
+
+  value_type value_at(size_t i, size_t position) const {
+    return (uint64_t(position - i) << l) | low_bits(i);
+  }
+
+  template <typename ForwardIterator>
+  void build(ForwardIterator first, ForwardIterator last) {
+    n = size_t(std::distance(first, last));
+    // the largest value rather than u, so that it cannot overflow
+    uint64_t m = n ? uint64_t(*std::max_element(first, last)) : 0;
+    // l = floor(log2(m / n)), which is at most 63
+    l = 0;
+    while (n && l < 63 && (m >> (l + 1)) >= n) ++l;
+    low.assign((n * l + 63) / 64 + 1, 0);
+    high_bits = n + size_t(m >> l) + 1;
+    // a guard word makes next_one stop at the end without a bounds check
+    high.assign(high_bits / 64 + 2, 0);
+    high[high_bits / 64] |= uint64_t(1) << (high_bits % 64);
+    size_t i(0);
+    while (first != last) {
+      uint64_t x = *first++;
+      set_low_bits(i, x & ((uint64_t(1) << l) - 1));
+      size_t position = size_t(x >> l) + i;
+      high[position / 64] |= uint64_t(1) << (position % 64);
+      if (i % select_sample == 0) one_samples.push_back(position);
+      ++i;
+    }
+    size_t zeros(0);
+    for (size_t position = 0; position < high_bits; ++position) {
+      if (!bit(high, position)) {
+        if (zeros % select_sample == 0) zero_samples.push_back(position);
+        ++zeros;
+      }
+    }
+  }
+
+public:
+  struct iterator_basis {
+    typedef std::random_access_iterator_tag iterator_category;
+    typedef uint64_t value_type;
+    typedef ptrdiff_t difference_type;
+    typedef value_type reference;
+    typedef void pointer;
+
+    struct state_type {
+      size_t index;
+      size_t position;   // of the index-th one in the high bits
+      state_type() : index(0), position(0) {}
+      state_type(size_t index, size_t position) : index(index), position(position) {}
+
+      friend
+      bool operator==(const state_type& x, const state_type& y) {
+        return x.index == y.index;
+      }
+    };
+
+    const elias_fano_sequence* s;
+    state_type st;
+
+    iterator_basis() : s(NULL) {}
+    iterator_basis(const elias_fano_sequence* s, size_t index, size_t position)
+      : s(s), st(index, position) {}
+
+    const state_type& state() const { return st; }
+
+    reference deref() const { return s->value_at(st.index, st.position); }
+
+    void increment() {
+      ++st.index;
+      st.position = s->next_one(st.position + 1);
+    }
+
+    void decrement() {
+      --st.index;
+      st.position = s->previous_one(st.position);
+    }
+
+    void increment(difference_type k) {
+      st.index += k;
+      st.position = s->one_position(st.index);
+    }
+
+    difference_type difference(const iterator_basis& x) const {
+      return difference_type(st.index) - difference_type(x.st.index);
+    }
+  };
+
+  typedef adapter::iterator<iterator_basis> const_iterator;
+  typedef const_iterator iterator;
+  typedef ptrdiff_t difference_type;
+
+  elias_fano_sequence() : n(0), l(0), high_bits(0) {
+    build((uint64_t*)NULL, (uint64_t*)NULL);
+  }
+
+  // requires [first, last) to be non-decreasing
+  template <typename ForwardIterator>
+  elias_fano_sequence(ForwardIterator first, ForwardIterator last) {
+    build(first, last);
+  }
+
+  size_t size() const { return n; }
+
+  bool empty() const { return n == 0; }
+
+  // returns the number of bytes used by the representation
+  size_t byte_size() const {
+    return sizeof(uint64_t) * (low.size() + high.size())
+         + sizeof(size_t) * (one_samples.size() + zero_samples.size());
+  }
+
+  // returns the position in the high bits of the i-th value, or of the
+  // guard bit if i == size()
+  size_t one_position(size_t i) const {
+    return i == n ? high_bits : select<false>(one_samples, i);
+  }
+
+  // requires i < size()
+  value_type access(size_t i) const {
+    return value_at(i, one_position(i));
+  }
+
+  value_type operator[](size_t i) const { return access(i); }
+
+  const_iterator begin() const {
+    return const_iterator(iterator_basis(this, 0, one_position(0)));
+  }
+
+  const_iterator end() const {
+    return const_iterator(iterator_basis(this, n, high_bits));
+  }
+
+  // returns the first position whose value is not less than x (or end())
+  const_iterator next_geq(value_type x) const {
+    size_t h = size_t(x >> l);
+    if (h >= high_bits - n) return end();  // h exceeds every high part
+    // the values with high part h start after the h-th zero
+    size_t position = h == 0 ? 0 : select<true>(zero_samples, h - 1) + 1;
+    size_t i = position - h;
+    if (i == n) return end();
+    position = next_one(position);
+    while (i != n && value_at(i, position) < x) {
+      ++i;
+      position = next_one(position + 1);
+    }
+    return const_iterator(iterator_basis(this, i, i == n ? high_bits : position));
+  }
+};
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 2
+// indent-tabs-mode: nil
+// End:
+#endif
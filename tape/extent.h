@@ -2,6 +2,8 @@
 #define EXTENT_H
 
 #include <stdint.h>
+#include <stddef.h>
+#include <stdlib.h>
 #include <algorithm>
 #include <new>
 
@@ -14,22 +16,90 @@ concept Copier<typename X>
        void {  x.move(first, last, result)  };
        void {  x.move_backward(first, last, result) };
        void {  x.clean_up(result, result_end) };
+       bool {  X::trivially_relocatable };
    }
 };
 
 concept Metadata<typename X> = Semiregular<X>;
 
+concept Allocator<typename X>
+= requires (size_t n, void* p) {
+       void* { X::allocate(n) };      // throws std::bad_alloc on failure
+       void  { X::deallocate(p, n) }; // n is the size passed to allocate
+       void* { X::reallocate(p, n, m) }; // NULL if the block cannot be resized
+   };
+
+concept GrowthPolicy<typename X>
+= requires (size_t size, size_t capacity, size_t additional) {
+       // a capacity of at least size + additional
+       size_t { X::capacity(size, capacity, additional) };
+   };
+
 The copier concept is here to allow possible generealization in the future.
 For example, we could use extent to re-implement std::vector replacing byte_copier
 with a copier templatized on T
 
-We can also re-architect extent to support different allocation policies - see EoP page 220
+Under C++11 an extent is moved by taking over its pointer, which leaves
+the moved-from extent empty.
+
+The allocator is a policy with static member functions rather than an
+object, so that the header of an extent remains one pointer (EoP page 220).
+malloc_allocator is the default; allocation_policy.h provides an arena
+and a size-class pool.
+
+When an extent runs out of capacity, the growth policy chooses the new
+capacity, and the extent first asks the allocator to resize the block
+with reallocate, which keeps the contents; only if it returns NULL is a
+new block allocated and the contents moved.  malloc_allocator uses
+realloc, which extends the block in place when the memory after it is
+free and, with glibc, resizes blocks allocated with mmap (the large
+ones) with mremap, so a large tape grows without a copy and without
+holding both blocks at once.  Resizing moves the bytes without the
+copier, so it is used only if the copier is trivially relocatable.
 
 */
 
 
 
+struct malloc_allocator {
+  static
+  void* allocate(size_t n) {
+    void* tmp = malloc(n);
+    if (tmp == NULL) throw std::bad_alloc();
+    return tmp;
+  }
+  static
+  void deallocate(void* p, size_t) { free(p); }
+
+  static
+  void* reallocate(void* p, size_t, size_t m) { return realloc(p, m); }
+};
+
+struct doubling_growth {
+  static
+  size_t capacity(size_t, size_t capacity, size_t additional) {
+    return capacity + std::max(capacity, additional);
+  }
+};
+
+struct one_and_a_half_growth {
+  static
+  size_t capacity(size_t, size_t capacity, size_t additional) {
+    return capacity + std::max(capacity / 2, additional);
+  }
+};
+
+// reallocates at every insertion: for tapes that are built once, or with
+// an allocator that resizes in place
+struct exact_growth {
+  static
+  size_t capacity(size_t size, size_t, size_t additional) {
+    return size + additional;
+  }
+};
+
 struct byte_copier {
+  enum { trivially_relocatable = true };
   void copy(const uint8_t* first, const uint8_t* last, uint8_t* result) {
     std::copy(first, last, result);
   }
@@ -42,7 +112,9 @@ struct byte_copier {
   void clean_up(uint8_t*, uint8_t*) {}
 };
 
-template <typename Metadata, typename Copier = byte_copier>
+template <typename Metadata, typename Copier = byte_copier,
+          typename Allocator = malloc_allocator,
+          typename Growth = doubling_growth>
 struct extent {
 
 private:
@@ -52,12 +124,6 @@ private:
 
   pointer start; 
 
-  pointer guarded_malloc(size_t n) {
-    void* tmp = malloc(n);
-    if (tmp == NULL) throw std::bad_alloc();
-    return pointer(tmp);
-  }
-
   struct header_t {
     size_t finish;
     size_t end_of_block;
@@ -130,10 +196,12 @@ public:
   bool empty() const { return !start; }
 
 private:
-  pointer new_block_start(size_t additional) {
-    size_t increment = std::max(byte_capacity(), additional);
-    size_t new_capacity = byte_capacity() + increment;
-    pointer block = guarded_malloc(sizeof(header_t) + new_capacity);
+  size_t grown_capacity(size_t additional) const {
+    return Growth::capacity(byte_size(), byte_capacity(), additional);
+  }
+
+  pointer new_block_start(size_t new_capacity) {
+    pointer block = pointer(Allocator::allocate(sizeof(header_t) + new_capacity));
 
     header_t* p_header = (header_t*)(block);
     p_header->metadata = start ? *metadata() : Metadata();   
@@ -145,21 +213,40 @@ private:
 
   void replace_start(pointer new_start) {
     pointer old_start = start;
+    size_t old_total_byte_size = total_byte_size();
     start = new_start;
-    if (old_start) free((void*)(old_start - sizeof(header_t)));
+    if (old_start) Allocator::deallocate(old_start - sizeof(header_t), old_total_byte_size);
   }
 
   void deallocate() { replace_start(NULL); }
 
+  // resizes the block keeping the contents, if the allocator can
+  bool resize_block(size_t new_capacity) {
+    if (!start || !Copier::trivially_relocatable) return false;
+    void* block = Allocator::reallocate(start - sizeof(header_t), total_byte_size(),
+                                        sizeof(header_t) + new_capacity);
+    if (block == NULL) return false;
+    start = pointer(block) + sizeof(header_t);
+    end_of_block() = new_capacity;
+    return true;
+  }
+
   void reallocate(size_t additional) {
-    pointer new_start = new_block_start(additional);
+    size_t new_capacity = grown_capacity(additional);
+    if (resize_block(new_capacity)) return;
+    pointer new_start = new_block_start(new_capacity);
     if (start) Copier().move(storage(), content_end(), new_start);
     replace_start(new_start);
   }
 
   void reallocate(size_t additional, size_t offset) {
     if (additional == 0) return;
-    pointer new_start = new_block_start(additional);
+    size_t new_capacity = grown_capacity(additional);
+    if (resize_block(new_capacity)) {
+      Copier().move_backward(start + offset, content_end(), content_end() + additional);
+      return;
+    }
+    pointer new_start = new_block_start(new_capacity);
     if (start) {
       Copier().move(start, start + offset, new_start); 
       Copier().move(start + offset, content_end(), new_start + offset + additional);
@@ -171,6 +258,7 @@ public:
 
   void adjust_byte_capacity(size_t n) {
     if (remaining_byte_capacity() != n) {
+      if (resize_block(byte_size() + n)) return;
       self tmp;
       tmp.reallocate(byte_size() + n);
       Copier().copy(start, content_end(), tmp.start);
@@ -229,6 +317,19 @@ public:
     return first;
   }
 
+  // gives up the block without deallocating it, leaving the extent empty
+  pointer release() {
+    pointer p = start;
+    start = NULL;
+    return p;
+  }
+
+  // takes over a block given up by release
+  void adopt(pointer p) {
+    deallocate();
+    start = p;
+  }
+
   ~extent() {  deallocate(); }
 
   extent() : start(NULL) {}
@@ -254,6 +355,20 @@ public:
     }
     return *this;
   }
+
+#if __cplusplus >= 201103L
+  // moving takes over the block and leaves x empty
+  extent(self&& x) noexcept : start(x.start) { x.start = NULL; }
+
+  self& operator=(self&& x) noexcept {
+    if (&x != this) {
+      deallocate();
+      start = x.start;
+      x.start = NULL;
+    }
+    return *this;
+  }
+#endif
 };
 
 // Local Variables:
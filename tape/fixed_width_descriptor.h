@@ -0,0 +1,85 @@
+#ifndef FIXED_WIDTH_DESCRIPTOR_H
+#define FIXED_WIDTH_DESCRIPTOR_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <iterator>
+#include <utility>
+
+// Only included for "concepts"
+#include "variable_size_type.h"
+
+/*
+
+Packs every value into the same number of bytes, Width, most significant
+byte first.  A column whose values all fit in Width bytes takes Width
+bytes per value instead of eight, and since every datum has the same size
+the descriptor satisfies RandomAccessVariableSizeTypeDescriptor: the
+iterators of tape<fixed_width_descriptor<Width> > are random access, so
+std::lower_bound over a sorted column takes O(log n) decodes.
+
+The width is in bytes, not bits: the iterators of a tape are positions of
+bytes.  Big-endian order makes the encoding order preserving, so tape
+comparisons compare raw bytes.
+
+*/
+
+template <size_t Width>
+struct fixed_width_descriptor {
+  typedef uint64_t value_type;
+  enum { equality_preserving = true };
+  enum { order_preserving = true };
+  enum { prefixed_size = true };
+  typedef std::random_access_iterator_tag iterator_category;
+
+  enum { width = Width };
+
+  // returns the largest value that fits in Width bytes
+  static
+  value_type max_value() {
+    return Width == 8 ? ~value_type(0) : (value_type(1) << (8 * (Width % 8))) - 1;
+  }
+
+  size_t datum_size() const { return Width; }
+
+  size_t size(const uint8_t*) const { return Width; }
+
+  size_t encoded_size(value_type) const { return Width; }
+
+  // requires x <= max_value()
+  uint8_t* encode(value_type x, uint8_t* dst) const {
+    for (size_t i = Width; i != 0; --i) *dst++ = uint8_t(x >> (8 * (i - 1)));
+    return dst;
+  }
+
+  value_type decode(const uint8_t* p) const {
+    value_type result(0);
+    for (size_t i = 0; i < Width; ++i) result = (result << 8) | p[i];
+    return result;
+  }
+
+  const uint8_t* previous(const uint8_t* origin,
+                          const uint8_t* current) const {
+    return current == origin ? current : current - Width;
+  }
+
+  std::pair<value_type, size_t> attributes_backward(const uint8_t* origin,
+                                                    const uint8_t* current) const {
+    if (current == origin) return std::make_pair(value_type(0), size_t(0));
+    return std::make_pair(decode(current - Width), size_t(Width));
+  }
+
+  std::pair<const uint8_t*, uint8_t*>
+  copy(const uint8_t* src, uint8_t* dst) const {
+    memcpy(dst, src, Width);
+    return std::make_pair(src + Width, dst + Width);
+  }
+};
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 2
+// indent-tabs-mode: nil
+// End:
+#endif
@@ -0,0 +1,325 @@
+#ifndef GAP_BUFFER_TAPE_H
+#define GAP_BUFFER_TAPE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <iterator>
+#include <algorithm>
+#include <utility>
+
+#include "variable_size_type.h"
+#include "iterator_adapter.h"
+#include "variable_size_type_iterator.h"
+#include "gap_extent.h"
+#include "tape.h"
+
+/*
+
+tape::insert in the middle of a tape moves all the bytes after the
+insertion point, and for an input range it also rotates them, so a
+burst of edits near one position of a long tape is quadratic.
+gap_buffer_tape is a tape whose extent is a gap_extent (gap_extent.h):
+the free space is kept at the last edit point, so inserting or erasing
+k values near it costs O(k), and editing elsewhere first moves the gap,
+which costs the bytes between the two points.  Appending is inserting
+at end(), which moves the gap to the end once.
+
+Its iterators are those of tape<VariableSizeTypeDescriptor> made to jump
+over the gap; a position is never the beginning of a (nonempty) gap, so
+that the iterator following the last value before the gap is the one
+of the first value after it.  They are at most bidirectional, and are
+invalidated by every insertion and erasure.  close_gap moves the gap to
+the end, after which the bytes of the values are one range, as in a
+tape.
+
+*/
+
+template <typename IteratorCategory>
+struct at_most_bidirectional {
+  typedef IteratorCategory type;
+};
+
+template <>
+struct at_most_bidirectional<std::random_access_iterator_tag> {
+  typedef std::bidirectional_iterator_tag type;
+};
+
+template <typename WritableVariableSizeTypeDescriptor,
+          typename Allocator = malloc_allocator,
+          typename Growth = doubling_growth>
+class gap_buffer_tape {
+public:
+  typedef WritableVariableSizeTypeDescriptor descriptor_type;
+  typedef typename descriptor_type::value_type value_type;
+  typedef value_type reference;
+  typedef value_type const_reference;
+  typedef size_t size_type;
+  typedef Allocator allocator_type;
+  typedef Growth growth_policy;
+
+  struct iterator_basis {
+    typedef typename tape<descriptor_type>::const_iterator local_iterator;
+    typedef typename tape<descriptor_type>::iterator_state local_state;
+    typedef typename at_most_bidirectional<
+      typename local_iterator::iterator_category>::type iterator_category;
+    typedef typename gap_buffer_tape::value_type value_type;
+    typedef ptrdiff_t difference_type;
+    typedef value_type reference;
+    typedef void pointer;
+    typedef typename local_iterator::state_type state_type;
+
+    local_iterator local;
+    const uint8_t* origin;
+    const uint8_t* gap_begin;  // NULL if there is no gap
+    const uint8_t* gap_end;
+
+    iterator_basis() : origin(NULL), gap_begin(NULL), gap_end(NULL) {}
+
+    iterator_basis(const uint8_t* origin, const uint8_t* gap_begin,
+                   const uint8_t* gap_end, const uint8_t* position,
+                   const descriptor_type& dsc)
+      : origin(origin), gap_begin(gap_begin), gap_end(gap_end) {
+      if (gap_begin == gap_end) {
+        this->gap_begin = this->gap_end = NULL;
+        local = local_iterator(local_state(origin, position, dsc));
+      } else {
+        if (position == gap_begin) position = gap_end;
+        // a value after the gap is not looked for before it
+        local = local_iterator(local_state(position < gap_end ? origin : gap_end,
+                                           position, dsc));
+      }
+    }
+
+    const state_type& state() const { return local.state(); }
+
+    reference deref() const { return *local; }
+
+    void increment() {
+      ++local;
+      if (local.state().position == gap_begin) {
+        local = local_iterator(local_state(gap_end, gap_end, local.state().dsc));
+      }
+    }
+
+    // requires a bidirectional descriptor
+    void decrement() {
+      if (gap_begin && local.state().position == gap_end) {
+        local = local_iterator(local_state(origin, gap_begin, local.state().dsc));
+      }
+      --local;
+    }
+  };
+
+  typedef adapter::iterator<iterator_basis> const_iterator;
+  typedef const_iterator iterator;
+  typedef typename const_iterator::difference_type difference_type;
+
+private:
+  typedef uint8_t* pointer;
+  typedef const uint8_t* const_pointer;
+
+  struct tape_metadata {
+    size_t number_of_elements;
+  };
+
+  gap_extent<tape_metadata, byte_copier, allocator_type, growth_policy> ext;
+  descriptor_type dsc;
+
+  static
+  const_pointer pos(const const_iterator& x) { return x.state().position; }
+
+  const_iterator make_iterator(const_pointer p) const {
+    return const_iterator(iterator_basis(ext.storage(), ext.gap_begin(), ext.gap_end(),
+                                         p, dsc));
+  }
+
+  void add_to_size(size_type n) {
+    if (ext.metadata()) ext.metadata()->number_of_elements += n;
+  }
+
+  struct value_writer {
+    value_type value;
+    descriptor_type dsc;
+    value_writer(const value_type& value, const descriptor_type& dsc)
+      : value(value), dsc(dsc) {}
+    void operator()(pointer p) { dsc.encode(value, p); }
+  };
+
+  template <typename ForwardIterator>
+  struct range_writer {
+    ForwardIterator first;
+    ForwardIterator last;
+    descriptor_type dsc;
+    range_writer(ForwardIterator first, ForwardIterator last, const descriptor_type& dsc)
+      : first(first), last(last), dsc(dsc) {}
+    void operator()(pointer p) { encode_range(first, last, p, dsc); }
+  };
+
+  // returns the offsets of the inserted bytes
+  std::pair<size_t, size_t> insert_value(size_t offset, const value_type& v) {
+    if (!ext.empty() && points_into(v, ext.storage(), ext.content_end())) {
+      // the value refers to bytes that moving the gap may move
+      tape<descriptor_type> tmp(dsc);
+      tmp.push_back(v);
+      return insert(offset, tmp.begin(), tmp.end(), std::forward_iterator_tag());
+    }
+    size_t n = dsc.encoded_size(v);
+    ext.insert_space(offset, n, value_writer(v, dsc));
+    add_to_size(1);
+    return std::make_pair(offset, offset + n);
+  }
+
+  // the values of an input range are encoded one at a time into the gap,
+  // which stays after the last one
+  template <typename InputIterator>
+  std::pair<size_t, size_t>
+  insert(size_t offset, InputIterator first, InputIterator last, std::input_iterator_tag) {
+    size_t end_offset = offset;
+    for (; first != last; ++first) end_offset = insert_value(end_offset, *first).second;
+    return std::make_pair(offset, end_offset);
+  }
+
+  template <typename ForwardIterator>
+  std::pair<size_t, size_t>
+  insert(size_t offset, ForwardIterator first, ForwardIterator last, std::forward_iterator_tag) {
+    std::pair<size_type, size_type> size_and_count = total_encoded_size(first, last, dsc);
+    ext.insert_space(offset, size_and_count.first,
+                     range_writer<ForwardIterator>(first, last, dsc));
+    add_to_size(size_and_count.second);
+    return std::make_pair(offset, offset + size_and_count.first);
+  }
+
+  // the iterators of the values between two offsets, after an insertion
+  std::pair<const_iterator, const_iterator> inserted_range(std::pair<size_t, size_t> x) {
+    return std::make_pair(make_iterator(ext.position(x.first)),
+                          make_iterator(ext.position(x.second)));
+  }
+
+public:
+  const gap_extent<tape_metadata, byte_copier, allocator_type, growth_policy>&
+  get_extent() const { return ext; }
+
+  bool empty() const { return ext.empty(); }
+
+  size_type size() const {
+    return ext.empty() ? size_type(0) : ext.metadata()->number_of_elements;
+  }
+
+  descriptor_type descriptor() const { return dsc; }
+
+  const_iterator begin() const { return make_iterator(ext.storage()); }
+
+  const_iterator end() const { return make_iterator(ext.content_end()); }
+
+  // inserts v before position; returns the iterator of v
+  const_iterator insert(const_iterator position, const value_type& v) {
+    size_t offset = insert_value(ext.offset(pos(position)), v).first;
+    return make_iterator(ext.position(offset));
+  }
+
+  // inserts the values of [first, last) before position, leaving the gap
+  // after them; returns the range of the inserted values
+  template <typename InputIterator>
+  std::pair<const_iterator, const_iterator>
+  insert(const_iterator position, InputIterator first, InputIterator last) {
+    typename std::iterator_traits<InputIterator>::iterator_category tag;
+    size_t offset = ext.offset(pos(position));
+    return inserted_range(insert(offset, unwrap_iterator(first), unwrap_iterator(last), tag));
+  }
+
+  void push_back(const value_type& v) {
+    insert_value(ext.byte_size(), v);
+  }
+
+  template <typename InputIterator>
+  void append(InputIterator first, InputIterator last) {
+    insert(end(), first, last);
+  }
+
+  // erases the values of [first, last), whose bytes join the gap; returns
+  // the iterator following them
+  const_iterator erase(const_iterator first, const_iterator last) {
+    size_type n = size_type(std::distance(first, last));
+    size_t offset = ext.offset(pos(first));
+    size_t erased_byte_size = ext.offset(pos(last)) - offset;
+    size_type remaining = size() - n;
+    if (!ext.erase_space(offset, erased_byte_size)) return end();
+    ext.metadata()->number_of_elements = remaining;
+    return make_iterator(ext.position(offset));
+  }
+
+  const_iterator erase(const_iterator position) {
+    const_iterator next = position;
+    return erase(position, ++next);
+  }
+
+  // moves the gap to offset in the bytes of the values, where a burst of
+  // edits is about to start
+  void move_gap(size_t offset) { ext.move_gap(offset); }
+
+  // moves the gap to the end and frees it, so that the bytes of the values
+  // are the range [get_extent().storage(), get_extent().content_end())
+  void close_gap() { ext.close_gap(); }
+
+  friend
+  inline
+  bool operator==(const gap_buffer_tape& x, const gap_buffer_tape& y) {
+    if (x.size() != y.size()) return false;
+    if (x.dsc.equality_preserving &&
+        x.ext.byte_size() != y.ext.byte_size()) return false;
+    return std::equal(x.begin(), x.end(), y.begin());
+  }
+
+  friend
+  inline
+  bool operator!=(const gap_buffer_tape& x, const gap_buffer_tape& y) {
+    return !(x == y);
+  }
+
+  friend
+  inline
+  bool operator<(const gap_buffer_tape& x, const gap_buffer_tape& y) {
+    return std::lexicographical_compare(x.begin(), x.end(), y.begin(), y.end());
+  }
+
+  friend
+  inline
+  bool operator>=(const gap_buffer_tape& x, const gap_buffer_tape& y) {
+    return !(x < y);
+  }
+
+  friend
+  inline
+  bool operator>(const gap_buffer_tape& x, const gap_buffer_tape& y) {
+    return y < x;
+  }
+
+  friend
+  inline
+  bool operator<=(const gap_buffer_tape& x, const gap_buffer_tape& y) {
+    return !(x > y);
+  }
+
+  gap_buffer_tape(const descriptor_type& dsc = descriptor_type())
+    : dsc(dsc) {}
+
+  template <typename InputIterator>
+  gap_buffer_tape(InputIterator first, InputIterator last,
+                  const descriptor_type& dsc = descriptor_type())
+    : dsc(dsc) {
+    insert(end(), first, last);
+  }
+
+  friend
+  void swap(gap_buffer_tape& x, gap_buffer_tape& y) {
+    swap(x.ext, y.ext);
+    std::swap(x.dsc, y.dsc);
+  }
+};
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 2
+// indent-tabs-mode: nil
+// End:
+#endif
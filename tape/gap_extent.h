@@ -0,0 +1,197 @@
+#ifndef GAP_EXTENT_H
+#define GAP_EXTENT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <algorithm>
+
+#include "extent.h"
+
+/*
+
+gap_extent is an extent used as a gap buffer: the free space of the
+block is not after the contents but inside them, at the position of the
+last insertion or erasure, and its position and size are kept in the
+header of the block next to the metadata:
+
+  bytes before the gap | gap | bytes after the gap
+
+Inserting or erasing at the gap costs only the bytes inserted; anywhere
+else, the gap is moved there first, which moves the bytes between its
+old and new position.  A sequence of k insertions and erasures near one
+position thus costs O(k) plus one move of the gap, instead of a move of
+the rest of the contents for every one of them.  When the gap is too
+small, the block grows by the growth policy and all of the new capacity
+goes to the gap.
+
+Positions are given as offsets in the contents without the gap.  The
+contents are two ranges of bytes, [storage(), gap_begin()) and
+[gap_end(), content_end()); close_gap makes them one range again by
+moving the gap to the end and giving its bytes back to the capacity of
+the extent.
+
+*/
+
+template <typename Metadata, typename Copier = byte_copier,
+          typename Allocator = malloc_allocator,
+          typename Growth = doubling_growth>
+struct gap_extent {
+
+private:
+  typedef uint8_t* pointer;
+  typedef const uint8_t* const_pointer;
+  typedef gap_extent self;
+
+  struct gap_metadata {
+    Metadata metadata;
+    size_t gap_offset;
+    size_t gap_size;
+
+    gap_metadata() : metadata(), gap_offset(0), gap_size(0) {}
+  };
+
+  typedef extent<gap_metadata, Copier, Allocator, Growth> extent_type;
+
+  extent_type ext;
+
+  struct no_writer {
+    void operator()(pointer) {}
+  };
+
+  // makes the gap at least n bytes, taking all the capacity given by the
+  // growth policy
+  void grow_gap(size_t n) {
+    size_t size = ext.byte_size();
+    size_t capacity = ext.empty() ? size_t(0) : ext.byte_capacity();
+    size_t added = Growth::capacity(size, capacity, n - gap_size()) - size;
+    ext.adjust_byte_capacity(added);
+    ext.insert_space(gap_end_non_const(), added, no_writer());
+    ext.metadata()->gap_size += added;
+  }
+
+  pointer gap_end_non_const() { return ext.storage() + gap_offset() + gap_size(); }
+
+public:
+  pointer storage() { return ext.storage(); }
+
+  const_pointer storage() const { return ext.storage(); }
+
+  Metadata* metadata() {
+    return ext.empty() ? NULL : &(ext.metadata()->metadata);
+  }
+
+  const Metadata* metadata() const {
+    return ext.empty() ? NULL : &(ext.metadata()->metadata);
+  }
+
+  // returns the offset of the gap in the contents
+  size_t gap_offset() const {
+    return ext.empty() ? size_t(0) : ext.metadata()->gap_offset;
+  }
+
+  // returns the size of the gap in bytes
+  size_t gap_size() const {
+    return ext.empty() ? size_t(0) : ext.metadata()->gap_size;
+  }
+
+  const_pointer gap_begin() const { return storage() + gap_offset(); }
+
+  const_pointer gap_end() const { return gap_begin() + gap_size(); }
+
+  // returns the size of the contents in bytes, without the gap
+  size_t byte_size() const { return ext.byte_size() - gap_size(); }
+
+  // the end of the bytes after the gap
+  const_pointer content_end() const { return ext.content_end(); }
+
+  // returns the total current data-holding capacity in bytes
+  size_t byte_capacity() const { return ext.byte_capacity(); }
+
+  // returns the size in bytes of the allocated extent
+  size_t total_byte_size() const { return ext.total_byte_size(); }
+
+  // returns the remaining capacity for data in bytes, with the gap
+  size_t remaining_byte_capacity() const { return byte_capacity() - byte_size(); }
+
+  // returns true if and only if the extent is empty
+  bool empty() const { return ext.empty(); }
+
+  // returns the offset in the contents of p, which is not inside the gap
+  size_t offset(const_pointer p) const {
+    return p <= gap_begin() ? size_t(p - storage()) : size_t(p - storage()) - gap_size();
+  }
+
+  // returns the position of offset in the contents, skipping the gap
+  pointer position(size_t offset) {
+    return storage() + (offset > gap_offset() ? offset + gap_size() : offset);
+  }
+
+  const_pointer position(size_t offset) const {
+    return storage() + (offset > gap_offset() ? offset + gap_size() : offset);
+  }
+
+  // moves the gap to offset in the contents
+  void move_gap(size_t offset) {
+    if (ext.empty()) return;
+    gap_metadata& m = *ext.metadata();
+    pointer p = ext.storage();
+    if (offset < m.gap_offset) {
+      Copier().move_backward(p + offset, p + m.gap_offset, p + m.gap_offset + m.gap_size);
+    } else if (offset > m.gap_offset) {
+      Copier().move(p + m.gap_offset + m.gap_size, p + offset + m.gap_size, p + m.gap_offset);
+    }
+    m.gap_offset = offset;
+  }
+
+  // inserts inserted_byte_size bytes at offset, written by writer, and
+  // leaves the gap after them; returns their position
+  template <typename Writer>
+  pointer insert_space(size_t offset, size_t inserted_byte_size, Writer writer) {
+    if (!inserted_byte_size) return position(offset);
+    move_gap(offset);
+    if (gap_size() < inserted_byte_size) grow_gap(inserted_byte_size);
+    gap_metadata& m = *ext.metadata();
+    pointer p = ext.storage() + m.gap_offset;
+    writer(p);
+    m.gap_offset += inserted_byte_size;
+    m.gap_size -= inserted_byte_size;
+    return p;
+  }
+
+  // erases erased_byte_size bytes at offset, which join the gap; frees
+  // the block and returns false if no bytes remain
+  bool erase_space(size_t offset, size_t erased_byte_size) {
+    if (!erased_byte_size) return !empty();
+    if (byte_size() == erased_byte_size) {
+      extent_type tmp;
+      swap(ext, tmp);
+      return false;
+    }
+    move_gap(offset);
+    ext.metadata()->gap_size += erased_byte_size;
+    return true;
+  }
+
+  // moves the gap to the end and gives it back to the capacity, so that
+  // the contents are [storage(), content_end())
+  void close_gap() {
+    if (!gap_size()) return;
+    size_t size = byte_size();
+    move_gap(size);
+    size_t n = gap_size();
+    ext.metadata()->gap_size = 0;
+    ext.erase_space(ext.storage() + size, n);
+  }
+
+  friend
+  void swap(self& x, self& y) {
+    swap(x.ext, y.ext);
+  }
+};
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 2
+// indent-tabs-mode: nil
+// End:
+#endif
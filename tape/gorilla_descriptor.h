@@ -0,0 +1,268 @@
+#ifndef GORILLA_DESCRIPTOR_H
+#define GORILLA_DESCRIPTOR_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <iterator>
+#include <utility>
+
+// Only included for "concepts"
+#include "variable_size_type.h"
+
+#include "value_block.h"
+
+/*
+
+XOR compression of a series of doubles (Pelkonen et al., "Gorilla: A Fast,
+Scalable, In-Memory Time Series Database", VLDB 2015).  Consecutive
+samples of a gauge are usually equal or close, so the XOR of a value with
+its predecessor is zero or has a short run of meaningful bits between
+long runs of leading and trailing zeros.  After the first value, which is
+stored verbatim, every value is written as
+
+  0                           the XOR is zero: the value repeats
+  1 0 <meaningful bits>       the meaningful bits fit in the previous window
+  1 1 <5 bits: leading zeros> <6 bits: number of meaningful bits> <meaningful bits>
+
+with the bits of the stream most significant first.
+
+Every value depends on the one before it, so the datum of the descriptor
+is a block of up to block_capacity values:
+
+  count | 2 bytes: size of the datum (little-endian) | bit stream
+
+Use it as tape<gorilla_descriptor> together with append_blocks and
+element_iterator from value_block.h.  The descriptor is not equality
+preserving: 0.0 == -0.0 and NaN != NaN, but their bits differ.
+
+*/
+
+struct gorilla_bit_writer {
+  uint8_t* dst;
+  uint64_t buffer;
+  unsigned bits;           // the number of pending bits at the bottom of buffer
+
+  gorilla_bit_writer(uint8_t* dst) : dst(dst), buffer(0), bits(0) {}
+
+  // requires width <= 32
+  void write_short(uint64_t x, unsigned width) {
+    buffer = (buffer << width) | x;
+    bits += width;
+    while (bits >= 8) {
+      bits -= 8;
+      *dst++ = uint8_t(buffer >> bits);
+    }
+  }
+
+  // requires x < 2^width, width <= 64
+  void write(uint64_t x, unsigned width) {
+    if (width > 32) {
+      write_short(x >> 32, width - 32);
+      width = 32;
+      x &= 0xffffffffull;
+    }
+    write_short(x, width);
+  }
+
+  uint8_t* flush() {
+    if (bits) *dst++ = uint8_t(buffer << (8 - bits));
+    bits = 0;
+    return dst;
+  }
+};
+
+struct gorilla_bit_counter {
+  size_t bits;
+
+  gorilla_bit_counter() : bits(0) {}
+
+  void write(uint64_t, unsigned width) { bits += width; }
+};
+
+// reads the stream from a 64-bit buffer holding the next bits at its top,
+// refilled by a big-endian word load while 8 bytes remain (Giesen,
+// "Reading bits in far too many ways")
+struct gorilla_bit_reader {
+  const uint8_t* src;
+  const uint8_t* last;
+  uint64_t buffer;
+  unsigned bits;           // the number of unread bits at the top of buffer
+
+  gorilla_bit_reader(const uint8_t* src, const uint8_t* last)
+    : src(src), last(last), buffer(0), bits(0) {}
+
+  // postcondition: bits >= 56
+  void refill() {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+    if (last - src >= 8) {
+      uint64_t word;
+      memcpy(&word, src, sizeof(word));
+      buffer |= __builtin_bswap64(word) >> bits;
+      src += (63 - bits) >> 3;
+      bits |= 56;
+      return;
+    }
+#endif
+    while (bits <= 56) {
+      buffer |= uint64_t(src != last ? *src++ : 0) << (56 - bits);
+      bits += 8;
+    }
+  }
+
+  // requires 0 < width <= bits
+  uint64_t take(unsigned width) {
+    uint64_t result = buffer >> (64 - width);
+    buffer <<= width;
+    bits -= width;
+    return result;
+  }
+
+  // requires 0 < width <= 64
+  uint64_t read(unsigned width) {
+    refill();
+    if (width <= 56) return take(width);
+    uint64_t high = take(width - 32);
+    refill();
+    return (high << 32) | take(32);
+  }
+};
+
+struct gorilla_descriptor {
+  enum { block_capacity = 128 };
+  typedef value_block<double, block_capacity> value_type;
+  enum { equality_preserving = false };
+  enum { order_preserving = false };
+  enum { prefixed_size = true };
+  typedef std::forward_iterator_tag iterator_category;
+
+  enum { header_size = 3 };
+
+  static
+  uint64_t bits_of(double x) {
+    uint64_t result;
+    memcpy(&result, &x, sizeof(result));
+    return result;
+  }
+
+  static
+  double double_of(uint64_t x) {
+    double result;
+    memcpy(&result, &x, sizeof(result));
+    return result;
+  }
+
+  template <typename BitWriter>
+  void write_values(const value_type& x, BitWriter& out) const {
+    if (x.empty()) return;
+    uint64_t previous = bits_of(x.values[0]);
+    out.write(previous, 64);
+    unsigned leading(65);  // no previous window
+    unsigned trailing(0);
+    for (size_t i = 1; i < x.count; ++i) {
+      uint64_t current = bits_of(x.values[i]);
+      uint64_t difference = current ^ previous;
+      previous = current;
+      if (!difference) {
+        out.write(0, 1);
+        continue;
+      }
+      unsigned l = unsigned(__builtin_clzll(difference));
+      unsigned t = unsigned(__builtin_ctzll(difference));
+      if (l > 31) l = 31;      // the leading zeros take 5 bits
+      if (leading <= l && trailing <= t) {
+        out.write(2, 2);
+        out.write(difference >> trailing, 64 - leading - trailing);
+      } else {
+        leading = l;
+        trailing = t;
+        unsigned meaningful = 64 - l - t;
+        out.write(3, 2);
+        out.write(l, 5);
+        out.write(meaningful & 63, 6); // 64 meaningful bits are written as 0
+        out.write(difference >> t, meaningful);
+      }
+    }
+  }
+
+  size_t encoded_size(const value_type& x) const {
+    gorilla_bit_counter counter;
+    write_values(x, counter);
+    return header_size + (counter.bits + 7) / 8;
+  }
+
+  uint8_t* encode(const value_type& x, uint8_t* dst) const {
+    gorilla_bit_writer out(dst + header_size);
+    write_values(x, out);
+    uint8_t* result = out.flush();
+    size_t n = result - dst;
+    dst[0] = uint8_t(x.count);
+    dst[1] = uint8_t(n);
+    dst[2] = uint8_t(n >> 8);
+    return result;
+  }
+
+  size_t size(const uint8_t* p) const {
+    return size_t(p[1]) | (size_t(p[2]) << 8);
+  }
+
+  // decodes the block at p into result and returns the number of values
+  size_t decode_values(const uint8_t* p, double* result) const {
+    size_t count = p[0];
+    if (!count) return 0;
+    gorilla_bit_reader in(p + header_size, p + size(p));
+    uint64_t previous = in.read(64);
+    *result++ = double_of(previous);
+    unsigned leading(0);
+    unsigned meaningful(0);
+    for (size_t i = 1; i < count; ++i) {
+      in.refill();             // the 13 control bits fit
+      if (in.take(1)) {
+        if (in.take(1)) {
+          leading = unsigned(in.take(5));
+          meaningful = unsigned(in.take(6));
+          if (!meaningful) meaningful = 64;
+        }
+        previous ^= in.read(meaningful) << (64 - leading - meaningful);
+      }
+      *result++ = double_of(previous);
+    }
+    return count;
+  }
+
+  value_type decode(const uint8_t* p) const {
+    value_type result;
+    result.count = decode_values(p, result.values);
+    return result;
+  }
+
+  std::pair<const uint8_t*, uint8_t*>
+  copy(const uint8_t* src, uint8_t* dst) const {
+    size_t n = size(src);
+    memcpy(dst, src, n);
+    return std::make_pair(src + n, dst + n);
+  }
+};
+
+// decodes the values of the blocks in the well-formed range [first, last)
+// into result, stopping before the first block that does not fit in n
+// values; returns the positions following the last read and written values
+inline
+std::pair<const uint8_t*, double*>
+decode_n(const uint8_t* first, const uint8_t* last, size_t n,
+         double* result,
+         const gorilla_descriptor& dsc) {
+  double* result_last = result + n;
+  while (first != last && size_t(result_last - result) >= *first) {
+    result += dsc.decode_values(first, result);
+    first += dsc.size(first);
+  }
+  return std::make_pair(first, result);
+}
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 2
+// indent-tabs-mode: nil
+// End:
+#endif
@@ -0,0 +1,177 @@
+#ifndef GROUP_VARINT_DESCRIPTOR_H
+#define GROUP_VARINT_DESCRIPTOR_H
+
+#include <assert.h>
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <iterator>
+#include <algorithm>
+#include <utility>
+
+// Only included for "concepts"
+#include "variable_size_type.h"
+
+#include "value_block.h"
+#include "length_code.h"
+#include "cpu_dispatch.h"
+
+/*
+
+Group Varint (Dean, WSDM 2009) encodes a group of four 32-bit values
+behind a single tag byte of 2-bit length codes, so the lengths of all four
+values are found by one table lookup instead of testing a continuation
+bit in every byte.
+
+To make the encoding bidirectional, every group also ends with a trailer
+byte holding the number of values in the group (minus one) in its top
+three bits and the number of data bytes in its low five bits:
+
+  tag | data bytes | trailer
+
+A group that is not full (normally only the last one) pads the missing
+values with one zero byte each.  The datum of the descriptor is the group,
+so use it as tape<group_varint_descriptor> together with append_blocks and
+element_iterator from value_block.h.
+
+*/
+
+struct group_varint_descriptor {
+  enum { block_capacity = 4 };
+  typedef value_block<uint32_t, block_capacity> value_type;
+  enum { equality_preserving = true };
+  enum { order_preserving = false };
+  enum { prefixed_size = true };
+  typedef std::bidirectional_iterator_tag iterator_category;
+
+  size_t encoded_size(const value_type& x) const {
+    size_t result = 2 + (4 - x.count);
+    for (size_t i = 0; i < x.count; ++i) result += length_code(x.values[i]) + 1;
+    return result;
+  }
+
+  // requires !x.empty(): the trailer has no count for an empty group
+  uint8_t* encode(const value_type& x, uint8_t* dst) const {
+    assert(x.count != 0);
+    uint8_t* tag = dst++;
+    *tag = 0;
+    for (size_t i = 0; i < 4; ++i) {
+      uint32_t v = i < x.count ? x.values[i] : uint32_t(0);
+      uint8_t code = length_code(v);
+      *tag |= uint8_t(code << (2 * i));
+      dst = store_little_endian(v, dst, code + 1);
+    }
+    size_t data_size = dst - tag - 1;
+    *dst++ = uint8_t(((x.count - 1) << 5) | data_size);
+    return dst;
+  }
+
+  size_t size(const uint8_t* p) const {
+    return 2 + length_code_table::instance().total[*p];
+  }
+
+  // decodes the group at p into result, which must have room for
+  // 4 values, and returns the number of values
+  size_t decode_values(const uint8_t* p, uint32_t* result) const {
+    const length_code_table& table = length_code_table::instance();
+    uint8_t tag = *p++;
+    for (size_t i = 0; i < 4; ++i) {
+      result[i] = load_little_endian(p + table.offset[tag][i], table.length[tag][i]);
+    }
+    return (p[table.total[tag]] >> 5) + 1;
+  }
+
+  value_type decode(const uint8_t* p) const {
+    value_type result;
+    result.count = decode_values(p, result.values);
+    return result;
+  }
+
+  const uint8_t* previous(const uint8_t* origin,
+                          const uint8_t* current) const {
+    if (current == origin) return current;
+    return current - 2 - (current[-1] & 0x1f);
+  }
+
+  std::pair<value_type, size_t> attributes_backward(const uint8_t* origin,
+                                                    const uint8_t* current) const {
+    if (current == origin) return std::make_pair(value_type(), size_t(0));
+    const uint8_t* p = previous(origin, current);
+    return std::make_pair(decode(p), size_t(current - p));
+  }
+
+  std::pair<const uint8_t*, uint8_t*>
+  copy(const uint8_t* src, uint8_t* dst) const {
+    size_t n = size(src);
+    memcpy(dst, src, n);
+    return std::make_pair(src + n, dst + n);
+  }
+};
+
+// the kernels below decode full groups while 20 bytes and 4 values of
+// output are left: a group takes at most 18 bytes and the loads read at
+// most 17 bytes from its start, so they stay within the range
+
+inline
+void group_varint_decode_groups(const uint8_t*& first, const uint8_t* last,
+                                uint32_t*& result, uint32_t* result_last) {
+  const length_code_table& table = length_code_table::instance();
+  while (last - first >= 20 && result_last - result >= 4) {
+    uint8_t tag = *first;
+    for (size_t i = 0; i < 4; ++i) {
+      result[i] = load_little_endian_word(first + 1 + table.offset[tag][i], table.length[tag][i]);
+    }
+    result += (first[1 + table.total[tag]] >> 5) + 1;
+    first += 2 + table.total[tag];
+  }
+}
+
+#ifdef TAPE_SSE41_KERNELS
+
+TAPE_TARGET_SSE41 inline
+void group_varint_decode_groups_shuffle(const uint8_t*& first, const uint8_t* last,
+                                        uint32_t*& result, uint32_t* result_last) {
+  const length_code_table& table = length_code_table::instance();
+  while (last - first >= 20 && result_last - result >= 4) {
+    uint8_t tag = *first;
+    __m128i bytes = _mm_loadu_si128((const __m128i*)(first + 1));
+    __m128i shuffle = _mm_loadu_si128((const __m128i*)table.shuffle[tag]);
+    _mm_storeu_si128((__m128i*)result, _mm_shuffle_epi8(bytes, shuffle));
+    result += (first[1 + table.total[tag]] >> 5) + 1;
+    first += 2 + table.total[tag];
+  }
+}
+
+#endif
+
+// decodes the values of the groups in the well-formed range [first, last)
+// into result, stopping before the first group that does not fit in n
+// values; returns the positions following the last read and written values
+inline
+std::pair<const uint8_t*, uint32_t*>
+decode_n(const uint8_t* first, const uint8_t* last, size_t n,
+         uint32_t* result,
+         const group_varint_descriptor& dsc) {
+  uint32_t* result_last = result + n;
+#ifdef TAPE_SSE41_KERNELS
+  if (current_cpu_level() >= sse41_cpu) {
+    group_varint_decode_groups_shuffle(first, last, result, result_last);
+  }
+#endif
+  group_varint_decode_groups(first, last, result, result_last);
+  while (first != last) {
+    uint32_t group[4];
+    size_t count = dsc.decode_values(first, group);
+    if (size_t(result_last - result) < count) break;
+    result = std::copy(group, group + count, result);
+    first += dsc.size(first);
+  }
+  return std::make_pair(first, result);
+}
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 2
+// indent-tabs-mode: nil
+// End:
+#endif
@@ -0,0 +1,502 @@
+#ifndef HYBRID_SET_H
+#define HYBRID_SET_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <iterator>
+#include <vector>
+#include <algorithm>
+#include <utility>
+
+#include "iterator_adapter.h"
+#include "vbyte_descriptor.h"
+#include "tape.h"
+
+/*
+
+A set of 32-bit values (document numbers) partitioned by their high 16
+bits into chunks, each stored in the representation that takes the least
+space for it, as in Roaring bitmaps (Chambi, Lemire, Kaser, Godin;
+Lemire et al., "Consistently faster and smaller compressed bitmaps with
+Roaring"):
+
+  array   the sorted low 16 bits of the values, 2 bytes per value: for
+          sparse chunks
+  bitmap  65536 bits, 8192 bytes: for dense chunks, intersected and
+          united a word at a time
+  runs    pairs of the first and last low bits of maximal runs of
+          consecutive values, 4 bytes per run: for chunks of long runs
+
+A dense term costs 8192 bytes per 65536 documents instead of at least a
+byte per document in tape<vbyte_descriptor>, and intersections of dense
+chunks are word operations instead of a merge.
+
+Like elias_fano_sequence the set is static: it is built from a
+non-decreasing range (duplicates are ignored), for example the iterators
+of a tape<vbyte_descriptor>, and set_intersection and set_union of two
+sets or of a set and a tape of values build new sets.  to_tape converts
+back.
+
+*/
+
+class hybrid_set {
+public:
+  typedef uint32_t value_type;
+  typedef size_t size_type;
+
+  enum kind_type { array_chunk, bitmap_chunk, run_chunk };
+  enum { chunk_bits = 65536, bitmap_words = chunk_bits / 64 };
+
+  struct chunk {
+    uint16_t key;               // the high 16 bits of the values
+    kind_type kind;
+    uint32_t cardinality;
+    std::vector<uint16_t> low;  // the values of an array, or the first and last value of every run
+    std::vector<uint64_t> words;
+
+    size_t byte_size() const {
+      return sizeof(uint16_t) * low.size() + sizeof(uint64_t) * words.size();
+    }
+
+    bool contains(uint16_t x) const {
+      switch (kind) {
+      case array_chunk:
+        return std::binary_search(low.begin(), low.end(), x);
+      case bitmap_chunk:
+        return (words[x / 64] >> (x % 64)) & 1;
+      default: {
+        // the first run whose last value is not less than x
+        size_t first(0);
+        size_t n = low.size() / 2;
+        while (n) {
+          size_t half = n / 2;
+          if (low[2 * (first + half) + 1] < x) {
+            first += half + 1;
+            n -= half + 1;
+          } else {
+            n = half;
+          }
+        }
+        return first != low.size() / 2 && low[2 * first] <= x;
+      }
+      }
+    }
+
+    // sets the bits of the values in the 1024 words at result
+    void set_bits(uint64_t* result) const {
+      switch (kind) {
+      case array_chunk:
+        for (size_t i = 0; i < low.size(); ++i) result[low[i] / 64] |= uint64_t(1) << (low[i] % 64);
+        break;
+      case bitmap_chunk:
+        for (size_t i = 0; i < bitmap_words; ++i) result[i] |= words[i];
+        break;
+      default:
+        for (size_t i = 0; i < low.size(); i += 2) set_range(result, low[i], low[i + 1]);
+      }
+    }
+
+    // builds the chunk of the sorted distinct low values [first, last)
+    template <typename ForwardIterator>
+    static
+    chunk from_sorted(uint16_t key, ForwardIterator first, ForwardIterator last) {
+      chunk result;
+      result.key = key;
+      result.cardinality = 0;
+      size_t runs(0);
+      uint32_t previous(0);
+      for (ForwardIterator i = first; i != last; ++i) {
+        if (!result.cardinality || *i != previous + 1) ++runs;
+        previous = *i;
+        ++result.cardinality;
+      }
+      result.kind = best_kind(result.cardinality, runs);
+      switch (result.kind) {
+      case array_chunk:
+        result.low.assign(first, last);
+        break;
+      case bitmap_chunk:
+        result.words.assign(bitmap_words, 0);
+        for (; first != last; ++first) result.words[*first / 64] |= uint64_t(1) << (*first % 64);
+        break;
+      default:
+        result.low.reserve(2 * runs);
+        while (first != last) {
+          uint16_t start = *first;
+          uint16_t end = start;
+          while (++first != last && *first == end + 1) end = *first;
+          result.low.push_back(start);
+          result.low.push_back(end);
+        }
+      }
+      return result;
+    }
+
+    // builds the chunk of the bits set in the 1024 words at bits
+    static
+    chunk from_bitmap(uint16_t key, const uint64_t* bits) {
+      chunk result;
+      result.key = key;
+      result.cardinality = 0;
+      size_t runs(0);
+      uint64_t carry(0);
+      for (size_t i = 0; i < bitmap_words; ++i) {
+        result.cardinality += uint32_t(__builtin_popcountll(bits[i]));
+        // a run starts at every set bit whose predecessor is clear
+        runs += size_t(__builtin_popcountll(bits[i] & ~((bits[i] << 1) | carry)));
+        carry = bits[i] >> 63;
+      }
+      result.kind = best_kind(result.cardinality, runs);
+      if (result.kind == bitmap_chunk) {
+        result.words.assign(bits, bits + bitmap_words);
+        return result;
+      }
+      std::vector<uint16_t> values;
+      values.reserve(result.cardinality);
+      for (size_t i = 0; i < bitmap_words; ++i) {
+        for (uint64_t w = bits[i]; w; w &= w - 1) {
+          values.push_back(uint16_t(i * 64 + size_t(__builtin_ctzll(w))));
+        }
+      }
+      return from_sorted(key, values.begin(), values.end());
+    }
+
+    // the representation taking the least space, preferring an array and
+    // then a bitmap on ties
+    static
+    kind_type best_kind(size_t cardinality, size_t runs) {
+      size_t array_size = 2 * cardinality;
+      size_t bitmap_size = 8 * bitmap_words;
+      size_t run_size = 4 * runs;
+      if (array_size <= bitmap_size && array_size <= run_size) return array_chunk;
+      if (bitmap_size <= run_size) return bitmap_chunk;
+      return run_chunk;
+    }
+
+    static
+    void set_range(uint64_t* bits, size_t first, size_t last) { // [first, last]
+      size_t first_word = first / 64;
+      size_t last_word = last / 64;
+      uint64_t first_mask = ~uint64_t(0) << (first % 64);
+      uint64_t last_mask = ~uint64_t(0) >> (63 - last % 64);
+      if (first_word == last_word) {
+        bits[first_word] |= first_mask & last_mask;
+        return;
+      }
+      bits[first_word] |= first_mask;
+      for (size_t i = first_word + 1; i < last_word; ++i) bits[i] = ~uint64_t(0);
+      bits[last_word] |= last_mask;
+    }
+  };
+
+private:
+  std::vector<chunk> chunks;
+  size_t n;
+
+  // returns the chunk with the given key, or NULL
+  const chunk* find_chunk(uint16_t key) const {
+    size_t first(0);
+    size_t count = chunks.size();
+    while (count) {
+      size_t half = count / 2;
+      if (chunks[first + half].key < key) {
+        first += half + 1;
+        count -= half + 1;
+      } else {
+        count = half;
+      }
+    }
+    return first != chunks.size() && chunks[first].key == key ? &chunks[first] : NULL;
+  }
+
+  void push_back(const chunk& x) {
+    if (!x.cardinality) return;
+    chunks.push_back(x);
+    n += x.cardinality;
+  }
+
+  template <typename InputIterator>
+  void build(InputIterator first, InputIterator last) {
+    std::vector<uint16_t> low;
+    uint32_t key(0);
+    while (first != last) {
+      uint32_t x = uint32_t(*first);
+      ++first;
+      if ((x >> 16) != key || low.empty()) {
+        if (!low.empty()) push_back(chunk::from_sorted(uint16_t(key), low.begin(), low.end()));
+        low.clear();
+        key = x >> 16;
+      }
+      if (low.empty() || low.back() != uint16_t(x)) low.push_back(uint16_t(x));
+    }
+    if (!low.empty()) push_back(chunk::from_sorted(uint16_t(key), low.begin(), low.end()));
+  }
+
+public:
+  struct iterator_basis {
+    typedef std::forward_iterator_tag iterator_category;
+    typedef uint32_t value_type;
+    typedef ptrdiff_t difference_type;
+    typedef value_type reference;
+    typedef void pointer;
+
+    struct state_type {
+      size_t chunk_index;
+      size_t index;   // in the array or in the runs of the chunk
+      uint32_t low;
+      state_type() : chunk_index(0), index(0), low(0) {}
+      state_type(size_t chunk_index, size_t index, uint32_t low)
+        : chunk_index(chunk_index), index(index), low(low) {}
+
+      friend
+      bool operator==(const state_type& x, const state_type& y) {
+        return x.chunk_index == y.chunk_index && x.low == y.low;
+      }
+    };
+
+    const hybrid_set* s;
+    state_type st;
+
+    iterator_basis() : s(NULL) {}
+    iterator_basis(const hybrid_set* s, size_t chunk_index) : s(s), st(chunk_index, 0, 0) {
+      start_chunk();
+    }
+
+    const state_type& state() const { return st; }
+
+    reference deref() const {
+      return (uint32_t(s->chunks[st.chunk_index].key) << 16) | st.low;
+    }
+
+    void start_chunk() {
+      st.index = 0;
+      st.low = 0;
+      if (st.chunk_index == s->chunks.size()) return;
+      const chunk& c = s->chunks[st.chunk_index];
+      if (c.kind == bitmap_chunk) {
+        st.low = uint32_t(-1);
+        next_bit(c);
+      } else {
+        st.low = c.low[0];
+      }
+    }
+
+    void next_bit(const chunk& c) {
+      size_t position = size_t(st.low + 1);
+      size_t word = position / 64;
+      uint64_t w = position % 64 ? c.words[word] & (~uint64_t(0) << (position % 64)) : c.words[word];
+      while (!w) w = c.words[++word];  // the last set bit is handled by increment
+      st.low = uint32_t(word * 64 + size_t(__builtin_ctzll(w)));
+    }
+
+    void next_chunk() {
+      ++st.chunk_index;
+      start_chunk();
+    }
+
+    void increment() {
+      const chunk& c = s->chunks[st.chunk_index];
+      switch (c.kind) {
+      case array_chunk:
+        if (++st.index == c.low.size()) next_chunk();
+        else st.low = c.low[st.index];
+        break;
+      case bitmap_chunk:
+        if (++st.index == c.cardinality) next_chunk();
+        else next_bit(c);
+        break;
+      default:
+        if (st.low != c.low[2 * st.index + 1]) {
+          ++st.low;
+        } else if (++st.index == c.low.size() / 2) {
+          next_chunk();
+        } else {
+          st.low = c.low[2 * st.index];
+        }
+      }
+    }
+  };
+
+  typedef adapter::iterator<iterator_basis> const_iterator;
+  typedef const_iterator iterator;
+  typedef ptrdiff_t difference_type;
+
+  hybrid_set() : n(0) {}
+
+  // requires [first, last) to be non-decreasing with values below 2^32
+  template <typename InputIterator>
+  hybrid_set(InputIterator first, InputIterator last) : n(0) {
+    build(first, last);
+  }
+
+  size_t size() const { return n; }
+
+  bool empty() const { return n == 0; }
+
+  const std::vector<chunk>& get_chunks() const { return chunks; }
+
+  // returns the number of bytes used by the chunks
+  size_t byte_size() const {
+    size_t result = sizeof(chunk) * chunks.size();
+    for (size_t i = 0; i < chunks.size(); ++i) result += chunks[i].byte_size();
+    return result;
+  }
+
+  bool contains(value_type x) const {
+    const chunk* c = find_chunk(uint16_t(x >> 16));
+    return c && c->contains(uint16_t(x));
+  }
+
+  const_iterator begin() const { return const_iterator(iterator_basis(this, 0)); }
+
+  const_iterator end() const { return const_iterator(iterator_basis(this, chunks.size())); }
+
+  // returns the values as a tape
+  template <typename WritableVariableSizeTypeDescriptor>
+  tape<WritableVariableSizeTypeDescriptor> to_tape(const WritableVariableSizeTypeDescriptor& dsc) const {
+    tape<WritableVariableSizeTypeDescriptor> result(dsc);
+    result.insert(result.end(), begin(), end());
+    return result;
+  }
+
+  tape<vbyte_descriptor> to_tape() const { return to_tape(vbyte_descriptor()); }
+
+  friend
+  hybrid_set set_intersection(const hybrid_set& x, const hybrid_set& y) {
+    hybrid_set result;
+    std::vector<uint64_t> bits(bitmap_words);
+    std::vector<uint16_t> values;
+    std::vector<chunk>::const_iterator i = x.chunks.begin();
+    std::vector<chunk>::const_iterator j = y.chunks.begin();
+    while (i != x.chunks.end() && j != y.chunks.end()) {
+      if (i->key < j->key) {
+        ++i;
+      } else if (j->key < i->key) {
+        ++j;
+      } else {
+        const chunk& a = i->cardinality <= j->cardinality ? *i : *j;
+        const chunk& b = i->cardinality <= j->cardinality ? *j : *i;
+        if (a.kind == array_chunk) {
+          // the smaller chunk is an array: keep the values found in the other
+          values.clear();
+          if (b.kind == array_chunk) {
+            std::set_intersection(a.low.begin(), a.low.end(), b.low.begin(), b.low.end(),
+                                  std::back_inserter(values));
+          } else {
+            for (size_t k = 0; k < a.low.size(); ++k) {
+              if (b.contains(a.low[k])) values.push_back(a.low[k]);
+            }
+          }
+          result.push_back(chunk::from_sorted(a.key, values.begin(), values.end()));
+        } else {
+          std::fill(bits.begin(), bits.end(), 0);
+          a.set_bits(&bits[0]);
+          if (b.kind == bitmap_chunk) {
+            for (size_t k = 0; k < bitmap_words; ++k) bits[k] &= b.words[k];
+          } else {
+            std::vector<uint64_t> other(bitmap_words);
+            b.set_bits(&other[0]);
+            for (size_t k = 0; k < bitmap_words; ++k) bits[k] &= other[k];
+          }
+          result.push_back(chunk::from_bitmap(a.key, &bits[0]));
+        }
+        ++i;
+        ++j;
+      }
+    }
+    return result;
+  }
+
+  friend
+  hybrid_set set_union(const hybrid_set& x, const hybrid_set& y) {
+    hybrid_set result;
+    std::vector<uint64_t> bits(bitmap_words);
+    std::vector<uint16_t> values;
+    std::vector<chunk>::const_iterator i = x.chunks.begin();
+    std::vector<chunk>::const_iterator j = y.chunks.begin();
+    while (i != x.chunks.end() || j != y.chunks.end()) {
+      if (j == y.chunks.end() || (i != x.chunks.end() && i->key < j->key)) {
+        result.push_back(*i++);
+      } else if (i == x.chunks.end() || j->key < i->key) {
+        result.push_back(*j++);
+      } else {
+        if (i->kind == array_chunk && j->kind == array_chunk &&
+            i->cardinality + j->cardinality <= bitmap_words * 4) {
+          values.clear();
+          std::set_union(i->low.begin(), i->low.end(), j->low.begin(), j->low.end(),
+                         std::back_inserter(values));
+          result.push_back(chunk::from_sorted(i->key, values.begin(), values.end()));
+        } else {
+          std::fill(bits.begin(), bits.end(), 0);
+          i->set_bits(&bits[0]);
+          j->set_bits(&bits[0]);
+          result.push_back(chunk::from_bitmap(i->key, &bits[0]));
+        }
+        ++i;
+        ++j;
+      }
+    }
+    return result;
+  }
+
+  // the values of the tape x are looked up chunk by chunk
+  template <typename VariableSizeTypeDescriptor>
+  friend
+  hybrid_set set_intersection(const hybrid_set& x, const tape<VariableSizeTypeDescriptor>& y) {
+    typedef typename tape<VariableSizeTypeDescriptor>::const_iterator iterator;
+    std::vector<uint32_t> values;
+    const chunk* c(NULL);
+    uint32_t key = ~uint32_t(0);
+    for (iterator i = y.begin(); i != y.end(); ++i) {
+      uint32_t v = uint32_t(*i);
+      if (v >> 16 != key) {
+        key = v >> 16;
+        c = x.find_chunk(uint16_t(key));
+      }
+      if (c && c->contains(uint16_t(v))) values.push_back(v);
+    }
+    return hybrid_set(values.begin(), values.end());
+  }
+
+  template <typename VariableSizeTypeDescriptor>
+  friend
+  hybrid_set set_intersection(const tape<VariableSizeTypeDescriptor>& x, const hybrid_set& y) {
+    return set_intersection(y, x);
+  }
+
+  template <typename VariableSizeTypeDescriptor>
+  friend
+  hybrid_set set_union(const hybrid_set& x, const tape<VariableSizeTypeDescriptor>& y) {
+    return set_union(x, hybrid_set(y.begin(), y.end()));
+  }
+
+  template <typename VariableSizeTypeDescriptor>
+  friend
+  hybrid_set set_union(const tape<VariableSizeTypeDescriptor>& x, const hybrid_set& y) {
+    return set_union(y, x);
+  }
+
+  friend
+  bool operator==(const hybrid_set& x, const hybrid_set& y) {
+    return x.size() == y.size() && std::equal(x.begin(), x.end(), y.begin());
+  }
+
+  friend
+  bool operator!=(const hybrid_set& x, const hybrid_set& y) {
+    return !(x == y);
+  }
+
+  friend
+  void swap(hybrid_set& x, hybrid_set& y) {
+    x.chunks.swap(y.chunks);
+    std::swap(x.n, y.n);
+  }
+};
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 2
+// indent-tabs-mode: nil
+// End:
+#endif
@@ -2,6 +2,7 @@
 #define ITERATOR_ADAPTER_H
 
 #include <stddef.h>
+#include <iostream>
 #include <iterator>
 
 namespace adapter {
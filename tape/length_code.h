@@ -0,0 +1,92 @@
+#ifndef LENGTH_CODE_H
+#define LENGTH_CODE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+
+/*
+
+Stream VByte and Group Varint both describe four 32-bit values by a
+single control byte holding four 2-bit codes; code c means that the
+value takes c + 1 little-endian bytes.  The code of the i-th value is in
+bits 2i and 2i + 1.
+
+length_code_table precomputes, for all 256 control bytes, the lengths
+and offsets of the four values, their total length and the shuffle that
+moves the bytes of the four values into four 32-bit lanes (an index of
+0x80 makes pshufb write a zero).
+
+*/
+
+inline
+uint8_t length_code(uint32_t x) {
+  return uint8_t((x > 0xff) + (x > 0xffff) + (x > 0xffffff));
+}
+
+struct length_code_table {
+  uint8_t length[256][4];
+  uint8_t offset[256][4];
+  uint8_t total[256];
+  uint8_t shuffle[256][16];
+
+  length_code_table() {
+    for (size_t c = 0; c < 256; ++c) {
+      memset(shuffle[c], 0x80, 16);
+      uint8_t n(0);
+      for (size_t i = 0; i < 4; ++i) {
+        length[c][i] = uint8_t(((c >> (2 * i)) & 3) + 1);
+        offset[c][i] = n;
+        for (size_t j = 0; j < length[c][i]; ++j) shuffle[c][4 * i + j] = uint8_t(n + j);
+        n += length[c][i];
+      }
+      total[c] = n;
+    }
+  }
+
+  static const length_code_table& instance() {
+    static const length_code_table table;
+    return table;
+  }
+};
+
+// reads the n <= 4 little-endian bytes at p
+inline
+uint32_t load_little_endian(const uint8_t* p, size_t n) {
+  uint32_t result(0);
+  while (n) {
+    --n;
+    result = (result << 8) | p[n];
+  }
+  return result;
+}
+
+// reads the n <= 4 little-endian bytes at p without branching on n;
+// requires 4 readable bytes at p
+inline
+uint32_t load_little_endian_word(const uint8_t* p, size_t n) {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+  uint32_t word;
+  memcpy(&word, p, sizeof(word));
+  return word & (~uint32_t(0) >> (32 - 8 * n));
+#else
+  return load_little_endian(p, n);
+#endif
+}
+
+// writes the n <= 4 low bytes of x in little-endian order
+inline
+uint8_t* store_little_endian(uint32_t x, uint8_t* p, size_t n) {
+  while (n--) {
+    *p++ = uint8_t(x);
+    x >>= 8;
+  }
+  return p;
+}
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 2
+// indent-tabs-mode: nil
+// End:
+#endif
@@ -0,0 +1,169 @@
+#ifndef ORDERED_INTEGER_DESCRIPTOR_H
+#define ORDERED_INTEGER_DESCRIPTOR_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <iterator>
+#include <utility>
+
+// Only included for "concepts"
+#include "variable_size_type.h"
+
+/*
+
+A variable-size integer encoding whose byte sequences compare in the same
+order as the values they encode, so that tape comparisons reduce to
+comparing the bytes of the extents (see operator< in tape.h).
+
+A value smaller than single_byte_limit is stored as a single byte; any
+other value as a length byte single_byte_limit - 1 + n followed by its n
+significant bytes, most significant first:
+
+  0x00 .. 0xf7                   values 0 .. 247
+  0xf8 b0                        values 248 .. 2^8 - 1
+  0xf9 b1 b0                     values 2^8 .. 2^16 - 1
+  ...
+  0xff b7 b6 b5 b4 b3 b2 b1 b0   values 2^56 .. 2^64 - 1
+
+Since n is the smallest possible, a longer datum encodes a larger value and
+starts with a larger byte; data of the same length compare as big-endian
+numbers.  Every datum knows its size from its first byte, so the encoding is
+prefix-free and the order extends to sequences of values.  The price is
+the bidirectional iteration of vbyte_descriptor: the start of the previous
+datum cannot be found from its end.
+
+*/
+
+struct ordered_integer_descriptor {
+  typedef uint64_t value_type;
+  enum { equality_preserving = true };
+  enum { order_preserving = true };
+  enum { prefixed_size = true };
+  typedef std::forward_iterator_tag iterator_category;
+
+  enum { single_byte_limit = 0xf8 };
+
+  // returns the number of significant bytes of x
+  static
+  size_t significant_bytes(value_type x) {
+    return x ? 8 - size_t(__builtin_clzll(x)) / 8 : 0;
+  }
+
+  uint8_t* encode(value_type x, uint8_t* dst) const {
+    if (x < single_byte_limit) {
+      *dst++ = uint8_t(x);
+      return dst;
+    }
+    size_t n = significant_bytes(x);
+    *dst++ = uint8_t(single_byte_limit - 1 + n);
+    while (n) *dst++ = uint8_t(x >> (8 * --n));
+    return dst;
+  }
+
+  size_t encoded_size(value_type x) const {
+    return x < single_byte_limit ? size_t(1) : 1 + significant_bytes(x);
+  }
+
+  // we assume that all the byte sequences passed to these functions are
+  // well-formed, that is, generated by encode
+
+  size_t size(const uint8_t* p) const {
+    return *p < single_byte_limit ? size_t(1) : size_t(*p) - (single_byte_limit - 2);
+  }
+
+  value_type decode(const uint8_t* p) const {
+    value_type result = *p;
+    if (result < single_byte_limit) return result;
+    size_t n = size_t(result) - (single_byte_limit - 1);
+    result = 0;
+    while (n--) result = (result << 8) | *++p;
+    return result;
+  }
+
+  std::pair<const uint8_t*, uint8_t*>
+  copy(const uint8_t* src, uint8_t* dst) const {
+    size_t n = size(src);
+    memcpy(dst, src, n);
+    return std::make_pair(src + n, dst + n);
+  }
+};
+
+/* Bulk encoding
+
+As for vbyte_descriptor, total_encoded_size and encode_range have
+overloads for arrays of uint64_t, which tape::insert uses when given
+pointers (as transcode does).  The encoder has no branch on the size of a
+value: it writes the length byte, then stores the 8 bytes of the value
+shifted to the top and byte-swapped, of which only the n significant
+ones belong to the datum.  The store may write past the end of the
+value, but not past the end of the 8 values that follow it, since each
+takes at least a byte; the last 8 values are encoded by
+ordered_integer_descriptor::encode.  The bytes are assumed to be stored
+little-endian.
+*/
+
+inline
+size_t ordered_integer_total_size(const uint64_t* first, const uint64_t* last) {
+  size_t result(last - first);
+  while (first != last) {
+    uint64_t x = *first++;
+    result += x < ordered_integer_descriptor::single_byte_limit ?
+      size_t(0) : ordered_integer_descriptor::significant_bytes(x);
+  }
+  return result;
+}
+
+// requires room for the total encoded size at dst
+inline
+uint8_t* ordered_integer_encode_word(const uint64_t* first, const uint64_t* last,
+                                     uint8_t* dst) {
+  const size_t limit = ordered_integer_descriptor::single_byte_limit;
+  while (last - first > 8) {
+    uint64_t x = *first++;
+    size_t n = ordered_integer_descriptor::significant_bytes(x);
+    bool small = x < limit;
+    // n is 0 only for x == 0, where the shift is masked to 0
+    uint64_t word = __builtin_bswap64(x << ((64 - 8 * n) & 63));
+    dst[0] = uint8_t(small ? x : limit - 1 + n);
+    memcpy(dst + 1, &word, sizeof(word));
+    dst += small ? 1 : 1 + n;
+  }
+  ordered_integer_descriptor dsc;
+  while (first != last) dst = dsc.encode(*first++, dst);
+  return dst;
+}
+
+inline
+std::pair<size_t, size_t>
+total_encoded_size(const uint64_t* first, const uint64_t* last,
+                   const ordered_integer_descriptor&) {
+  return std::make_pair(ordered_integer_total_size(first, last), size_t(last - first));
+}
+
+inline
+std::pair<size_t, size_t>
+total_encoded_size(uint64_t* first, uint64_t* last,
+                   const ordered_integer_descriptor& dsc) {
+  return total_encoded_size((const uint64_t*)first, (const uint64_t*)last, dsc);
+}
+
+// requires room for the total encoded size at dst
+inline
+uint8_t* encode_range(const uint64_t* first, const uint64_t* last, uint8_t* dst,
+                      const ordered_integer_descriptor&) {
+  return ordered_integer_encode_word(first, last, dst);
+}
+
+inline
+uint8_t* encode_range(uint64_t* first, uint64_t* last, uint8_t* dst,
+                      const ordered_integer_descriptor& dsc) {
+  return encode_range((const uint64_t*)first, (const uint64_t*)last, dst, dsc);
+}
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 2
+// indent-tabs-mode: nil
+// End:
+#endif
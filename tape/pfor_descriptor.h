@@ -0,0 +1,153 @@
+#ifndef PFOR_DESCRIPTOR_H
+#define PFOR_DESCRIPTOR_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <iterator>
+#include <utility>
+
+// Only included for "concepts"
+#include "variable_size_type.h"
+
+#include "value_block.h"
+#include "bit_packing.h"
+
+/*
+
+Patched frame of reference (PForDelta, Zukowski, Heman, Nes, Boncz) packs
+a block of values at a fixed bit width b chosen so that most values fit;
+the few values that do not (the exceptions) keep their low b bits in the
+packed array and have their high bits patched in afterwards.  Unlike the
+byte-aligned codecs it spends exactly b bits on a small value, so blocks
+of small gaps with rare outliers compress much better than with vbyte.
+
+The datum is a block of up to block_capacity values:
+
+  count | b | e | h | count values of b bits | e exception indices | e high parts of h bits
+
+where e is the number of exceptions and h the width of their high parts.
+Use it as tape<pfor_descriptor> together with append_blocks and
+element_iterator from value_block.h.
+
+*/
+
+struct pfor_descriptor {
+  enum { block_capacity = 128 };
+  typedef value_block<uint32_t, block_capacity> value_type;
+  enum { equality_preserving = true };
+  enum { order_preserving = false };
+  enum { prefixed_size = true };
+  typedef std::forward_iterator_tag iterator_category;
+
+  enum { header_size = 4 };
+
+  struct layout {
+    unsigned b;            // width of the packed values
+    size_t exceptions;
+    unsigned h;            // width of the high parts of the exceptions
+  };
+
+  static
+  size_t layout_size(size_t count, const layout& l) {
+    return header_size + packed_size(count, l.b)
+         + l.exceptions + packed_size(l.exceptions, l.h);
+  }
+
+  // chooses the width minimizing the encoded size
+  layout best_layout(const value_type& x) const {
+    size_t widths[33] = { 0 };  // the number of values of each bit width
+    for (size_t i = 0; i < x.count; ++i) ++widths[bit_width(x.values[i])];
+    unsigned max_width(32);
+    while (max_width && !widths[max_width]) --max_width;
+    layout best = { max_width, 0, 0 };
+    layout l = best;
+    while (l.b) {
+      l.exceptions += widths[l.b];
+      --l.b;
+      l.h = max_width - l.b;
+      if (layout_size(x.count, l) < layout_size(x.count, best)) best = l;
+    }
+    return best;
+  }
+
+  size_t encoded_size(const value_type& x) const {
+    return layout_size(x.count, best_layout(x));
+  }
+
+  uint8_t* encode(const value_type& x, uint8_t* dst) const {
+    layout l = best_layout(x);
+    *dst++ = uint8_t(x.count);
+    *dst++ = uint8_t(l.b);
+    *dst++ = uint8_t(l.exceptions);
+    *dst++ = uint8_t(l.h);
+    dst = pack_bits(x.values, x.count, l.b, dst);
+    uint32_t high[block_capacity];
+    size_t e(0);
+    for (size_t i = 0; i < x.count; ++i) {
+      if (bit_width(x.values[i]) > l.b) {
+        *dst++ = uint8_t(i);
+        high[e++] = uint32_t(uint64_t(x.values[i]) >> l.b);
+      }
+    }
+    return pack_bits(high, e, l.h, dst);
+  }
+
+  size_t size(const uint8_t* p) const {
+    layout l = { p[1], p[2], p[3] };
+    return layout_size(p[0], l);
+  }
+
+  // decodes the block at p into result and returns the number of values
+  size_t decode_values(const uint8_t* p, uint32_t* result) const {
+    size_t count = p[0];
+    unsigned b = p[1];
+    size_t e = p[2];
+    unsigned h = p[3];
+    const uint8_t* indices = unpack_bits(p + header_size, count, b, result);
+    if (e) {
+      uint32_t high[block_capacity];
+      unpack_bits(indices + e, e, h, high);
+      for (size_t i = 0; i < e; ++i) {
+        result[indices[i]] |= uint32_t(uint64_t(high[i]) << b);
+      }
+    }
+    return count;
+  }
+
+  value_type decode(const uint8_t* p) const {
+    value_type result;
+    result.count = decode_values(p, result.values);
+    return result;
+  }
+
+  std::pair<const uint8_t*, uint8_t*>
+  copy(const uint8_t* src, uint8_t* dst) const {
+    size_t n = size(src);
+    memcpy(dst, src, n);
+    return std::make_pair(src + n, dst + n);
+  }
+};
+
+// decodes the values of the blocks in the well-formed range [first, last)
+// into result, stopping before the first block that does not fit in n
+// values; returns the positions following the last read and written values
+inline
+std::pair<const uint8_t*, uint32_t*>
+decode_n(const uint8_t* first, const uint8_t* last, size_t n,
+         uint32_t* result,
+         const pfor_descriptor& dsc) {
+  uint32_t* result_last = result + n;
+  while (first != last && size_t(result_last - result) >= *first) {
+    result += dsc.decode_values(first, result);
+    first += dsc.size(first);
+  }
+  return std::make_pair(first, result);
+}
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 2
+// indent-tabs-mode: nil
+// End:
+#endif
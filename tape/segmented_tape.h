@@ -0,0 +1,400 @@
+#ifndef SEGMENTED_TAPE_H
+#define SEGMENTED_TAPE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <iterator>
+#include <algorithm>
+#include <deque>
+
+#include "variable_size_type.h"
+#include "iterator_adapter.h"
+#include "extent.h"
+#include "tape.h"
+
+/*
+
+A tape is one extent, so a tape of several gigabytes needs one block of
+several gigabytes, and every time it grows all of its bytes are copied.
+segmented_tape is a sequence of tapes, its segments, each allocated once
+with segment_byte_size bytes of capacity (or the size of a value, if it
+is larger); a value goes to the last segment if it fits and to a new
+segment otherwise.  Appending a value costs amortized O(1) and never
+copies the bytes already stored; only the deque of segments grows, by
+one tape per segment_byte_size bytes.  A value is never split between
+two segments, so every segment is a tape of its own, and since the
+segments are allocated with their full capacity a short segmented_tape
+takes segment_byte_size bytes.
+
+The iterators are segmented iterators (Austern, "Segmented Iterators and
+Hierarchical Algorithms"): a position is a segment together with an
+iterator of the tape of the segment, and end() is the end of the last
+segment.  copy, equal, decode_into and decode_block work on the segments
+one at a time, so that each of them is a contiguous range of bytes given
+to the algorithm of the tape (byte copies and comparisons when the
+descriptor allows it, the bulk decoders of the descriptor otherwise).
+
+Appending invalidates the iterators, but not the segments nor the bytes
+stored in them.
+
+*/
+
+template <typename WritableVariableSizeTypeDescriptor,
+          typename Allocator = malloc_allocator,
+          size_t SegmentByteSize = 64 * 1024>
+class segmented_tape {
+public:
+  typedef WritableVariableSizeTypeDescriptor descriptor_type;
+  typedef tape<descriptor_type, Allocator, exact_growth> segment_type;
+  typedef std::deque<segment_type> segment_sequence;
+  typedef typename descriptor_type::value_type value_type;
+  typedef value_type reference;
+  typedef value_type const_reference;
+  typedef size_t size_type;
+  typedef Allocator allocator_type;
+
+  enum { segment_byte_size = SegmentByteSize };
+
+  struct iterator_basis {
+    typedef typename segment_sequence::const_iterator segment_iterator;
+    typedef typename segment_type::const_iterator local_iterator;
+    typedef typename local_iterator::iterator_category iterator_category;
+    typedef typename segmented_tape::value_type value_type;
+    typedef typename local_iterator::difference_type difference_type;
+    typedef value_type reference;
+    typedef void pointer;
+
+    struct state_type {
+      segment_iterator segment;
+      segment_iterator last_segment;  // of the tape, to stop at end()
+      local_iterator local;
+
+      state_type() {}
+      state_type(segment_iterator segment, segment_iterator last_segment,
+                 local_iterator local)
+        : segment(segment), last_segment(last_segment), local(local) {}
+
+      friend
+      bool operator==(const state_type& x, const state_type& y) {
+        return x.segment == y.segment && x.local == y.local;
+      }
+    };
+
+    state_type st;
+
+    iterator_basis() {}
+    iterator_basis(const state_type& st) : st(st) {}
+
+    const state_type& state() const { return st; }
+
+    reference deref() const { return *st.local; }
+
+    // the local iterator is at the end of its segment only at end()
+    void increment() {
+      ++st.local;
+      if (st.local == st.segment->end() && st.segment != st.last_segment) {
+        ++st.segment;
+        st.local = st.segment->begin();
+      }
+    }
+
+    // requires a bidirectional descriptor
+    void decrement() {
+      if (st.local == st.segment->begin()) {
+        --st.segment;
+        st.local = st.segment->end();
+      }
+      --st.local;
+    }
+  };
+
+  typedef adapter::iterator<iterator_basis> const_iterator;
+  typedef const_iterator iterator;
+  typedef typename const_iterator::difference_type difference_type;
+  typedef typename iterator_basis::segment_iterator segment_iterator;
+  typedef typename iterator_basis::local_iterator local_iterator;
+
+private:
+  typedef typename iterator_basis::state_type state_type;
+
+  segment_sequence segs;
+  size_type number_of_values;
+  descriptor_type dsc;
+
+  // returns the last segment, after adding one unless it has room for n bytes
+  segment_type& segment_for(size_t n) {
+    if (segs.empty() || segs.back().get_extent().remaining_byte_capacity() < n) {
+      segs.push_back(segment_type(dsc));
+      segs.back().adjust_byte_capacity(std::max(n, size_t(segment_byte_size)));
+    }
+    return segs.back();
+  }
+
+  const_iterator make_iterator(segment_iterator segment, local_iterator local) const {
+    return const_iterator(iterator_basis(state_type(segment, segs.end() - 1, local)));
+  }
+
+  // the values of an input range are copied into a buffer of about 8KB,
+  // as in tape::append
+  template <typename InputIterator>
+  void append(InputIterator first, InputIterator last, std::input_iterator_tag) {
+    typedef typename std::iterator_traits<InputIterator>::value_type T;
+    T buffer[(8192 + sizeof(T) - 1) / sizeof(T)];
+    T* buffer_last = buffer + sizeof(buffer) / sizeof(T);
+    while (first != last) {
+      T* p = buffer;
+      while (first != last && p != buffer_last) *p++ = *first++;
+      append(buffer, p, std::forward_iterator_tag());
+    }
+  }
+
+  // appends the longest prefix that fits in the last segment with one
+  // tape::append, until the range is exhausted
+  template <typename ForwardIterator>
+  void append(ForwardIterator first, ForwardIterator last, std::forward_iterator_tag) {
+    while (first != last) {
+      segment_type& s = segment_for(dsc.encoded_size(*first));
+      size_t room = s.get_extent().remaining_byte_capacity();
+      size_t bytes = 0;
+      size_type n = 0;
+      ForwardIterator middle = first;
+      while (middle != last) {
+        size_t k = dsc.encoded_size(*middle);
+        if (room - bytes < k) break;
+        bytes += k;
+        ++n;
+        ++middle;
+      }
+      s.append(first, middle);
+      number_of_values += n;
+      first = middle;
+    }
+  }
+
+public:
+  const segment_sequence& get_segments() const { return segs; }
+
+  size_type number_of_segments() const { return segs.size(); }
+
+  bool empty() const { return number_of_values == 0; }
+
+  size_type size() const { return number_of_values; }
+
+  descriptor_type descriptor() const { return dsc; }
+
+  // returns the size of the contents of all the segments in bytes
+  size_type byte_size() const {
+    size_type n = 0;
+    for (segment_iterator i = segs.begin(); i != segs.end(); ++i) {
+      n += i->get_extent().byte_size();
+    }
+    return n;
+  }
+
+  // returns the size in bytes of the allocated extents
+  size_type total_byte_size() const {
+    size_type n = 0;
+    for (segment_iterator i = segs.begin(); i != segs.end(); ++i) {
+      n += i->get_extent().total_byte_size();
+    }
+    return n;
+  }
+
+  // the iterators of an empty segmented_tape are those of an empty tape
+  const_iterator begin() const {
+    if (segs.empty()) {
+      return const_iterator(iterator_basis(state_type(segs.end(), segs.end(),
+                                                      segment_type().end())));
+    }
+    return make_iterator(segs.begin(), segs.front().begin());
+  }
+
+  const_iterator end() const {
+    if (segs.empty()) return begin();
+    return make_iterator(segs.end() - 1, segs.back().end());
+  }
+
+  void push_back(const value_type& v) {
+    segment_for(dsc.encoded_size(v)).push_back(v);
+    ++number_of_values;
+  }
+
+  // appends the values of [first, last), with one tape::append per
+  // segment for a forward range and per segment and buffer for an input
+  // range
+  template <typename InputIterator>
+  void append(InputIterator first, InputIterator last) {
+    typename std::iterator_traits<InputIterator>::iterator_category tag;
+    append(unwrap_iterator(first), unwrap_iterator(last), tag);
+  }
+
+  void clear() {
+    segs.clear();
+    number_of_values = 0;
+  }
+
+  // decodes the first values, at most n, into result, a segment at a
+  // time; returns the position following the last written value
+  template <typename T>
+  T* decode_into(T* result, size_type n) const {
+    for (segment_iterator i = segs.begin(); i != segs.end() && n != 0; ++i) {
+      size_type m = std::min(n, i->size());
+      result = i->decode_into(result, m);
+      n -= m;
+    }
+    return result;
+  }
+
+  // decodes at most n values starting at cursor into result and advances
+  // cursor past them, without crossing the end of its segment; returns
+  // the number of values written, which is 0 only at end() under the
+  // condition of tape::decode_block
+  template <typename T>
+  size_type decode_block(const_iterator& cursor, T* result, size_type n) const {
+    if (segs.empty()) return size_type(0);
+    segment_iterator segment = cursor.state().segment;
+    local_iterator local = cursor.state().local;
+    size_type m = segment->decode_block(local, result, n);
+    if (local == segment->end() && segment != segs.end() - 1) {
+      ++segment;
+      local = segment->begin();
+    }
+    cursor = make_iterator(segment, local);
+    return m;
+  }
+
+  // Segmented algorithms
+
+  // copies the values of each segment of [first, last) with the copy of
+  // the tape, so that copying to a variable_size output iterator of the
+  // same descriptor copies the bytes
+  template <typename OutputIterator>
+  friend
+  OutputIterator copy(const_iterator first, const_iterator last, OutputIterator result) {
+    segment_iterator segment = first.state().segment;
+    local_iterator local = first.state().local;
+    while (segment != last.state().segment) {
+      result = copy_segment(local, segment->end(), result);
+      ++segment;
+      local = segment->begin();
+    }
+    return copy_segment(local, last.state().local, result);
+  }
+
+  friend
+  bool equal(const_iterator first1, const_iterator last1, const_iterator first2) {
+    if (first1 == last1) return true;
+    if (first1.state().segment->descriptor().equality_preserving) {
+      // equal byte sequences are equal sequences of values, wherever the
+      // segments of the two ranges end
+      const uint8_t* p = byte_position(first1.state().local);
+      const uint8_t* q = byte_position(first2.state().local);
+      segment_iterator s1 = first1.state().segment;
+      segment_iterator s2 = first2.state().segment;
+      while (true) {
+        const uint8_t* p_last = s1 == last1.state().segment ?
+          byte_position(last1.state().local) : s1->get_extent().content_end();
+        const uint8_t* q_last = s2->get_extent().content_end();
+        size_t k = std::min(size_t(p_last - p), size_t(q_last - q));
+        if (memcmp(p, q, k) != 0) return false;
+        p += k;
+        q += k;
+        if (p == p_last) {
+          if (s1 == last1.state().segment) return true;
+          ++s1;
+          p = s1->get_extent().storage();
+        }
+        if (q == q_last) {
+          ++s2;
+          q = s2->get_extent().storage();
+        }
+      }
+    }
+    for (; first1 != last1; ++first1, ++first2) {
+      if (!(*first1 == *first2)) return false;
+    }
+    return true;
+  }
+
+private:
+  static
+  const uint8_t* byte_position(const local_iterator& x) { return x.state().position; }
+
+  template <typename OutputIterator>
+  static
+  OutputIterator copy_segment(local_iterator first, local_iterator last, OutputIterator result) {
+    return std::copy(first, last, result);
+  }
+
+  typedef adapter::output_iterator<variable_size_output_iterator_basis<descriptor_type> >
+    byte_output_iterator;
+
+  static
+  byte_output_iterator copy_segment(local_iterator first, local_iterator last,
+                                    byte_output_iterator result) {
+    return ::copy(first, last, result);
+  }
+
+public:
+  friend
+  inline
+  bool operator==(const segmented_tape& x, const segmented_tape& y) {
+    if (x.size() != y.size()) return false;
+    return equal(x.begin(), x.end(), y.begin());
+  }
+
+  friend
+  inline
+  bool operator!=(const segmented_tape& x, const segmented_tape& y) {
+    return !(x == y);
+  }
+
+  friend
+  inline
+  bool operator<(const segmented_tape& x, const segmented_tape& y) {
+    return std::lexicographical_compare(x.begin(), x.end(), y.begin(), y.end());
+  }
+
+  friend
+  inline
+  bool operator>=(const segmented_tape& x, const segmented_tape& y) {
+    return !(x < y);
+  }
+
+  friend
+  inline
+  bool operator>(const segmented_tape& x, const segmented_tape& y) {
+    return y < x;
+  }
+
+  friend
+  inline
+  bool operator<=(const segmented_tape& x, const segmented_tape& y) {
+    return !(x > y);
+  }
+
+  segmented_tape(const descriptor_type& dsc = descriptor_type())
+    : number_of_values(0), dsc(dsc) {}
+
+  template <typename InputIterator>
+  segmented_tape(InputIterator first, InputIterator last,
+                 const descriptor_type& dsc = descriptor_type())
+    : number_of_values(0), dsc(dsc) {
+    append(first, last);
+  }
+
+  friend
+  void swap(segmented_tape& x, segmented_tape& y) {
+    x.segs.swap(y.segs);
+    std::swap(x.number_of_values, y.number_of_values);
+    std::swap(x.dsc, y.dsc);
+  }
+};
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 2
+// indent-tabs-mode: nil
+// End:
+#endif
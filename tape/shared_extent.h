@@ -0,0 +1,202 @@
+#ifndef SHARED_EXTENT_H
+#define SHARED_EXTENT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <algorithm>
+
+#include "extent.h"
+
+/*
+
+shared_extent has the interface of extent, but copying it shares the
+block instead of copying the bytes, so that a tape<D, A, G, shared_extent>
+is copied in constant time.  The number of shared_extents referring to a
+block is kept in the header of the block, next to the metadata, and
+every operation that may modify the bytes or the metadata first makes
+the block unique, copying it if it is shared (copy on write).  Obtaining
+a non-const pointer to the storage counts as a modification.
+
+The reference count is updated with atomic operations, so a reader on
+another thread can keep a copy of a tape (a snapshot) alive and read it
+while a writer modifies its own copy: the writer copies the block before
+its first modification, and whichever of them drops the last reference
+frees it.  As with any other type, one shared_extent must not be
+modified by two threads, or modified while another thread reads it.
+
+*/
+
+template <typename Metadata, typename Copier = byte_copier,
+          typename Allocator = malloc_allocator,
+          typename Growth = doubling_growth>
+struct shared_extent {
+
+private:
+  typedef uint8_t* pointer;
+  typedef const uint8_t* const_pointer;
+  typedef shared_extent self;
+
+  // a new or copied header starts with one reference
+  struct shared_metadata {
+    Metadata metadata;
+    size_t references;
+
+    shared_metadata() : references(1) {}
+    shared_metadata(const shared_metadata& x) : metadata(x.metadata), references(1) {}
+    shared_metadata& operator=(const shared_metadata& x) {
+      metadata = x.metadata;
+      references = 1;
+      return *this;
+    }
+  };
+
+  typedef extent<shared_metadata, Copier, Allocator, Growth> extent_type;
+
+  extent_type ext;
+
+#if defined(__GNUC__)
+  static
+  void increment(size_t& x) { __atomic_add_fetch(&x, 1, __ATOMIC_RELAXED); }
+
+  // returns the number of remaining references
+  static
+  size_t decrement(size_t& x) { return __atomic_sub_fetch(&x, 1, __ATOMIC_ACQ_REL); }
+
+  static
+  size_t load(const size_t& x) { return __atomic_load_n(&x, __ATOMIC_ACQUIRE); }
+#else
+  static
+  void increment(size_t& x) { ++x; }
+
+  static
+  size_t decrement(size_t& x) { return --x; }
+
+  static
+  size_t load(const size_t& x) { return x; }
+#endif
+
+  size_t& references() { return ext.metadata()->references; }
+
+  // gives up the reference of ext, freeing the block if it was the last one
+  void drop(extent_type& x) {
+    if (x.empty()) return;
+    if (decrement(x.metadata()->references) != 0) x.release();
+  }
+
+  // makes the block of ext unique, copying it if it is shared
+  void unshare() {
+    if (ext.empty() || load(references()) == 1) return;
+    extent_type copy(ext);
+    swap(ext, copy);
+    drop(copy);
+  }
+
+public:
+  // returns the number of shared_extents sharing the block, 0 if empty
+  size_t use_count() const {
+    return ext.empty() ? size_t(0) : load(ext.metadata()->references);
+  }
+
+  pointer storage() {
+    unshare();
+    return ext.storage();
+  }
+
+  const_pointer storage() const { return ext.storage(); }
+
+  Metadata* metadata() {
+    unshare();
+    return ext.empty() ? NULL : &(ext.metadata()->metadata);
+  }
+
+  const Metadata* metadata() const {
+    return ext.empty() ? NULL : &(ext.metadata()->metadata);
+  }
+
+  // returns the size of the contents in bytes
+  size_t byte_size() const { return ext.byte_size(); }
+
+  pointer content_end() { return storage() + byte_size(); }
+
+  const_pointer content_end() const { return storage() + byte_size(); }
+
+  // returns the total current data-holding capacity in bytes
+  size_t byte_capacity() const { return ext.byte_capacity(); }
+
+  // returns the size in bytes of the allocated extent
+  size_t total_byte_size() const { return ext.total_byte_size(); }
+
+  // returns the remaining capacity for data in bytes
+  size_t remaining_byte_capacity() const { return ext.remaining_byte_capacity(); }
+
+  // returns true if and only if the extent is empty
+  bool empty() const { return ext.empty(); }
+
+  void adjust_byte_capacity(size_t n) {
+    unshare();
+    ext.adjust_byte_capacity(n);
+  }
+
+  template <typename Writer>
+  pointer insert_space(pointer position, size_t inserted_byte_size, Writer writer) {
+    size_t offset(position - ext.storage());
+    unshare();
+    return ext.insert_space(ext.storage() + offset, inserted_byte_size, writer);
+  }
+
+  template <typename Writer>
+  pointer insert_space(size_t inserted_byte_size, Writer writer) {
+    unshare();
+    return ext.insert_space(inserted_byte_size, writer);
+  }
+
+  pointer erase_space(pointer first, size_t erased_byte_size) {
+    size_t offset(first - ext.storage());
+    unshare();
+    return ext.erase_space(ext.storage() + offset, erased_byte_size);
+  }
+
+  ~shared_extent() { drop(ext); }
+
+  shared_extent() {}
+
+  shared_extent(const self& x) {
+    if (!x.empty()) {
+      // the count is in the block, not in x
+      increment(const_cast<shared_metadata*>(x.ext.metadata())->references);
+      ext.adopt(const_cast<pointer>(x.ext.storage()));
+    }
+  }
+
+  friend
+  void swap(self& x, self& y) {
+    swap(x.ext, y.ext);
+  }
+
+  self& operator=(const self& x) {
+    if (&x != this) {
+      self tmp(x);
+      swap(*this, tmp);
+    }
+    return *this;
+  }
+
+#if __cplusplus >= 201103L
+  shared_extent(self&& x) noexcept : ext(static_cast<extent_type&&>(x.ext)) {}
+
+  self& operator=(self&& x) noexcept {
+    if (&x != this) {
+      self tmp(static_cast<self&&>(x));
+      swap(*this, tmp);
+    }
+    return *this;
+  }
+#endif
+};
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 2
+// indent-tabs-mode: nil
+// End:
+#endif
@@ -0,0 +1,265 @@
+#ifndef SMALL_EXTENT_H
+#define SMALL_EXTENT_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <algorithm>
+
+#include "extent.h"
+
+/*
+
+small_extent has the interface of extent but keeps up to inline_capacity
+bytes in the object itself, without allocating and without a header.
+It is 15 bytes with an alignment of 1, so tape<D, A, G, small_extent>
+with an empty descriptor is 16 bytes, the same as a tape with an extent:
+
+  inline:  up to 14 bytes | the number of bytes
+  large:   the pointer of an extent (not aligned) | 0xff
+
+When an insertion does not fit, the bytes move to an extent with the
+capacity chosen by the growth policy as if the inline bytes were its
+capacity, and the small_extent keeps its pointer; adjust_byte_capacity
+with a capacity that fits brings them back.  A large small_extent
+forwards to the extent, adopting its block for the duration of the call.
+
+An inline small_extent has no metadata: metadata() returns NULL, and a
+tape counts its values by iterating over the (at most 14) bytes, for
+size() and when they move to an extent.
+
+Since the bytes of an inline small_extent are inside the object, moving
+or swapping it invalidates the pointers to them, as well as the
+iterators of the tape.
+
+*/
+
+template <typename Metadata, typename Copier = byte_copier,
+          typename Allocator = malloc_allocator,
+          typename Growth = doubling_growth>
+struct small_extent {
+
+public:
+  enum { inline_capacity = 14 };
+
+private:
+  typedef uint8_t* pointer;
+  typedef const uint8_t* const_pointer;
+  typedef small_extent self;
+  typedef extent<Metadata, Copier, Allocator, Growth> extent_type;
+
+  enum { large_tag = 0xff };
+
+  // the bytes, or the pointer of the block of an extent; the last byte is
+  // the number of bytes or large_tag
+  uint8_t bytes[inline_capacity + 1];
+
+  uint8_t& tag() { return bytes[inline_capacity]; }
+
+  uint8_t tag() const { return bytes[inline_capacity]; }
+
+  pointer block() const {
+    pointer p;
+    memcpy(&p, bytes, sizeof(p));
+    return p;
+  }
+
+  void set_block(pointer p) {
+    if (p) {
+      memcpy(bytes, &p, sizeof(p));
+      tag() = uint8_t(large_tag);
+    } else {
+      tag() = 0;
+    }
+  }
+
+  // an extent owning the block while in scope, which gives it back
+  struct borrowed {
+    self& x;
+    extent_type ext;
+    borrowed(self& x) : x(x) { ext.adopt(x.block()); }
+    ~borrowed() { x.set_block(ext.release()); }
+  };
+
+  // an extent reading the block of a large small_extent
+  struct viewed {
+    extent_type ext;
+    viewed(const self& x) { ext.adopt(x.block()); }
+    ~viewed() { ext.release(); }
+  };
+
+  struct copy_writer {
+    const_pointer first;
+    const_pointer last;
+    copy_writer(const_pointer first, const_pointer last) : first(first), last(last) {}
+    void operator()(pointer p) { Copier().copy(first, last, p); }
+  };
+
+  // moves the inline bytes to an extent with the given capacity
+  void spill(size_t capacity) {
+    extent_type ext;
+    ext.adjust_byte_capacity(capacity);
+    ext.insert_space(size_t(tag()), copy_writer(bytes, bytes + tag()));
+    set_block(ext.release());
+  }
+
+public:
+  // returns true if and only if the bytes are stored in the object
+  bool is_inline() const { return tag() != large_tag; }
+
+  pointer storage() { return is_inline() ? bytes : block(); }
+
+  const_pointer storage() const { return is_inline() ? bytes : block(); }
+
+  Metadata* metadata() {
+    return is_inline() ? NULL : viewed(*this).ext.metadata();
+  }
+
+  const Metadata* metadata() const {
+    return is_inline() ? NULL : viewed(*this).ext.metadata();
+  }
+
+  // returns the size of the contents in bytes
+  size_t byte_size() const {
+    return is_inline() ? size_t(tag()) : viewed(*this).ext.byte_size();
+  }
+
+  pointer content_end() { return storage() + byte_size(); }
+
+  const_pointer content_end() const { return storage() + byte_size(); }
+
+  // returns the total current data-holding capacity in bytes
+  size_t byte_capacity() const {
+    return is_inline() ? size_t(inline_capacity) : viewed(*this).ext.byte_capacity();
+  }
+
+  // returns the size in bytes of the allocated extent, 0 if inline
+  size_t total_byte_size() const {
+    return is_inline() ? size_t(0) : viewed(*this).ext.total_byte_size();
+  }
+
+  // returns the remaining capacity for data in bytes
+  size_t remaining_byte_capacity() const {
+    return byte_capacity() - byte_size();
+  }
+
+  // returns true if and only if there are no bytes
+  bool empty() const { return byte_size() == 0; }
+
+  // an inline small_extent keeps the inline capacity
+  void adjust_byte_capacity(size_t n) {
+    size_t size = byte_size();
+    if (size + n <= inline_capacity) {
+      if (!is_inline()) {
+        extent_type ext;
+        ext.adopt(block());
+        Copier().move(ext.storage(), ext.content_end(), bytes);
+        tag() = uint8_t(size);
+      }
+    } else if (is_inline()) {
+      spill(size + n);
+    } else {
+      borrowed b(*this);
+      b.ext.adjust_byte_capacity(n);
+    }
+  }
+
+  template <typename Writer>
+  pointer insert_space(pointer position, size_t inserted_byte_size, Writer writer) {
+    if (!inserted_byte_size) return position;
+    if (is_inline()) {
+      size_t size = tag();
+      size_t offset = position - bytes;
+      if (size + inserted_byte_size <= inline_capacity) {
+        Copier().move_backward(bytes + offset, bytes + size,
+                               bytes + size + inserted_byte_size);
+        writer(bytes + offset);
+        tag() = uint8_t(size + inserted_byte_size);
+        return bytes + offset;
+      }
+      spill(Growth::capacity(size, inline_capacity, inserted_byte_size));
+      position = block() + offset;
+    }
+    borrowed b(*this);
+    return b.ext.insert_space(position, inserted_byte_size, writer);
+  }
+
+  template <typename Writer>
+  pointer insert_space(size_t inserted_byte_size, Writer writer) {
+    if (is_inline()) return insert_space(content_end(), inserted_byte_size, writer);
+    borrowed b(*this);
+    return b.ext.insert_space(inserted_byte_size, writer);
+  }
+
+  // returns NULL if no bytes remain
+  pointer erase_space(pointer first, size_t erased_byte_size) {
+    if (!erased_byte_size) return first;
+    if (is_inline()) {
+      pointer last = first + erased_byte_size;
+      pointer old_content_end = content_end();
+      Copier().move(last, old_content_end, first);
+      tag() -= uint8_t(erased_byte_size);
+      Copier().clean_up(content_end(), old_content_end);
+      return tag() ? first : NULL;
+    }
+    borrowed b(*this);
+    return b.ext.erase_space(first, erased_byte_size);
+  }
+
+  ~small_extent() {
+    if (!is_inline()) {
+      extent_type ext;
+      ext.adopt(block());
+    }
+  }
+
+  small_extent() { tag() = 0; }
+
+  small_extent(const self& x) {
+    tag() = 0;
+    if (x.byte_size() <= inline_capacity) {
+      Copier().copy(x.storage(), x.content_end(), bytes);
+      tag() = uint8_t(x.byte_size());
+    } else {
+      viewed v(x);
+      extent_type copy(v.ext);
+      set_block(copy.release());
+    }
+  }
+
+  friend
+  void swap(self& x, self& y) {
+    std::swap_ranges(x.bytes, x.bytes + inline_capacity + 1, y.bytes);
+  }
+
+  self& operator=(const self& x) {
+    if (&x != this) {
+      self tmp(x);
+      swap(*this, tmp);
+    }
+    return *this;
+  }
+
+#if __cplusplus >= 201103L
+  // moving copies the 15 bytes and leaves x empty
+  small_extent(self&& x) noexcept {
+    std::copy(x.bytes, x.bytes + inline_capacity + 1, bytes);
+    x.tag() = 0;
+  }
+
+  self& operator=(self&& x) noexcept {
+    if (&x != this) {
+      self tmp(static_cast<self&&>(x));
+      swap(*this, tmp);
+    }
+    return *this;
+  }
+#endif
+};
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 2
+// indent-tabs-mode: nil
+// End:
+#endif
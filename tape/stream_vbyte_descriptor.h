@@ -0,0 +1,170 @@
+#ifndef STREAM_VBYTE_DESCRIPTOR_H
+#define STREAM_VBYTE_DESCRIPTOR_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <iterator>
+#include <utility>
+
+// Only included for "concepts"
+#include "variable_size_type.h"
+
+#include "value_block.h"
+#include "length_code.h"
+#include "cpu_dispatch.h"
+
+/*
+
+Stream VByte (Lemire, Kurz, Rupp) keeps the lengths of the values apart
+from their bytes.  In vbyte_descriptor the length of a value is only known
+after looking at every one of its bytes, so decoding is a serial chain of
+data-dependent branches; here the control bytes tell where every value
+starts before any data byte is read, and four values are decoded by a
+single shuffle.
+
+Since the control bytes are shared between values, the datum of the
+descriptor is a block of up to block_capacity values:
+
+  count | ceil(count / 4) control bytes | data bytes
+
+Use it as tape<stream_vbyte_descriptor> together with append_blocks and
+element_iterator from value_block.h.
+
+*/
+
+struct stream_vbyte_descriptor {
+  enum { block_capacity = 128 };
+  typedef value_block<uint32_t, block_capacity> value_type;
+  enum { equality_preserving = true };
+  enum { order_preserving = false };
+  enum { prefixed_size = true };
+  typedef std::forward_iterator_tag iterator_category;
+
+  static
+  size_t control_size(size_t count) { return (count + 3) / 4; }
+
+  // returns the number of data bytes of count values described by control
+  size_t data_size(const uint8_t* control, size_t count) const {
+    const length_code_table& table = length_code_table::instance();
+    size_t result(0);
+    const uint8_t* control_last = control + count / 4;
+    while (control != control_last) result += table.total[*control++];
+    for (size_t i = 0; i < count % 4; ++i) result += table.length[*control][i];
+    return result;
+  }
+
+  size_t encoded_size(const value_type& x) const {
+    size_t result = 1 + control_size(x.count);
+    for (size_t i = 0; i < x.count; ++i) result += length_code(x.values[i]) + 1;
+    return result;
+  }
+
+  uint8_t* encode(const value_type& x, uint8_t* dst) const {
+    *dst++ = uint8_t(x.count);
+    uint8_t* control = dst;
+    uint8_t* data = control + control_size(x.count);
+    memset(control, 0, control_size(x.count));
+    for (size_t i = 0; i < x.count; ++i) {
+      uint8_t code = length_code(x.values[i]);
+      control[i / 4] |= uint8_t(code << (2 * (i % 4)));
+      data = store_little_endian(x.values[i], data, code + 1);
+    }
+    return data;
+  }
+
+  size_t size(const uint8_t* p) const {
+    size_t count = *p;
+    return 1 + control_size(count) + data_size(p + 1, count);
+  }
+
+#ifdef TAPE_SSE41_KERNELS
+  // decodes the quads of [control, control_last) with a shuffle each while
+  // 16 bytes of data are readable
+  TAPE_TARGET_SSE41
+  static
+  void decode_quads_shuffle(const uint8_t*& control, const uint8_t* control_last,
+                            const uint8_t*& data, const uint8_t* data_last,
+                            uint32_t*& r) {
+    const length_code_table& table = length_code_table::instance();
+    while (control != control_last && data_last - data >= 16) {
+      __m128i bytes = _mm_loadu_si128((const __m128i*)data);
+      __m128i shuffle = _mm_loadu_si128((const __m128i*)table.shuffle[*control]);
+      _mm_storeu_si128((__m128i*)r, _mm_shuffle_epi8(bytes, shuffle));
+      data += table.total[*control++];
+      r += 4;
+    }
+  }
+#endif
+
+  // decodes the block at p into result and returns the number of values
+  size_t decode_values(const uint8_t* p, uint32_t* result) const {
+    const length_code_table& table = length_code_table::instance();
+    const size_t count = *p++;
+    const uint8_t* control = p;
+    const uint8_t* control_last = control + count / 4;
+    const uint8_t* data = control + control_size(count);
+    const uint8_t* data_last = data + data_size(control, count);
+    uint32_t* r = result;
+#ifdef TAPE_SSE41_KERNELS
+    if (current_cpu_level() >= sse41_cpu) {
+      decode_quads_shuffle(control, control_last, data, data_last, r);
+    }
+#endif
+    // the quad takes at most 16 bytes, so every value has 4 readable bytes
+    while (control != control_last && data_last - data >= 16) {
+      uint8_t c = *control++;
+      for (size_t i = 0; i < 4; ++i) {
+        *r++ = load_little_endian_word(data + table.offset[c][i], table.length[c][i]);
+      }
+      data += table.total[c];
+    }
+    while (control != control_last) {
+      uint8_t c = *control++;
+      for (size_t i = 0; i < 4; ++i) {
+        *r++ = load_little_endian(data + table.offset[c][i], table.length[c][i]);
+      }
+      data += table.total[c];
+    }
+    for (size_t i = 0; i < count % 4; ++i) {
+      *r++ = load_little_endian(data + table.offset[*control][i], table.length[*control][i]);
+    }
+    return count;
+  }
+
+  value_type decode(const uint8_t* p) const {
+    value_type result;
+    result.count = decode_values(p, result.values);
+    return result;
+  }
+
+  std::pair<const uint8_t*, uint8_t*>
+  copy(const uint8_t* src, uint8_t* dst) const {
+    size_t n = size(src);
+    memcpy(dst, src, n);
+    return std::make_pair(src + n, dst + n);
+  }
+};
+
+// decodes the values of the blocks in the well-formed range [first, last)
+// into result, stopping before the first block that does not fit in n
+// values; returns the positions following the last read and written values
+inline
+std::pair<const uint8_t*, uint32_t*>
+decode_n(const uint8_t* first, const uint8_t* last, size_t n,
+         uint32_t* result,
+         const stream_vbyte_descriptor& dsc) {
+  uint32_t* result_last = result + n;
+  while (first != last && size_t(result_last - result) >= *first) {
+    result += dsc.decode_values(first, result);
+    first += dsc.size(first);
+  }
+  return std::make_pair(first, result);
+}
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 2
+// indent-tabs-mode: nil
+// End:
+#endif
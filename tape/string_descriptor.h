@@ -0,0 +1,237 @@
+#ifndef STRING_DESCRIPTOR_H
+#define STRING_DESCRIPTOR_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <iterator>
+#include <algorithm>
+#include <iostream>
+#include <string>
+#include <utility>
+
+// Only included for "concepts"
+#include "variable_size_type.h"
+
+#include "vbyte_descriptor.h"
+
+/*
+
+Descriptors for tapes of byte strings, so that a vocabulary or a set of
+n-gram keys takes one extent instead of a node and a heap block per string.
+
+string_descriptor stores the vbyte-encoded length followed by the bytes.
+Its value type is string_ref, a pointer and a length referring to the
+bytes inside the tape, so iterating over the tape does not copy: a
+string_ref is valid as long as the tape is not modified.  Pushing a
+string_ref back into the tape it refers to copies the string first (see
+points_into in variable_size_type.h); as for std::vector, the range
+given to insert or append must not be the tape's own.  A length
+prefix cannot preserve order ("b" has a smaller length than "ab"), so
+tape comparisons decode the strings.
+
+ordered_string_descriptor stores the bytes followed by the terminator
+0x00 0x01, writing every 0x00 byte of the string as 0x00 0xff (as in the
+key encodings of ordered key-value stores).  A 0x00 byte is always
+followed by 0x01 or 0xff, so the terminator is unambiguous in both
+directions, and since 0x01 < 0xff a string sorts before its extensions:
+the encoding preserves order and tape::operator< compares raw bytes.  The
+escapes mean that the bytes cannot be referred to in place, so the value
+type is std::string.
+
+*/
+
+// refers to the n bytes starting at first
+struct string_ref {
+  typedef const char* const_iterator;
+  typedef const char* iterator;
+  typedef char value_type;
+  typedef size_t size_type;
+
+  const char* first;
+  size_t n;
+
+  string_ref() : first(NULL), n(0) {}
+  string_ref(const char* first, size_t n) : first(first), n(n) {}
+  string_ref(const char* s) : first(s), n(strlen(s)) {}
+  string_ref(const std::string& s) : first(s.data()), n(s.size()) {}
+
+  const char* data() const { return first; }
+  size_t size() const { return n; }
+  bool empty() const { return n == 0; }
+  const char* begin() const { return first; }
+  const char* end() const { return first + n; }
+  char operator[](size_t i) const { return first[i]; }
+
+  std::string str() const { return std::string(first, n); }
+
+  friend
+  bool operator==(const string_ref& x, const string_ref& y) {
+    return x.n == y.n && (x.n == 0 || memcmp(x.first, y.first, x.n) == 0);
+  }
+
+  friend
+  bool operator!=(const string_ref& x, const string_ref& y) {
+    return !(x == y);
+  }
+
+  // compares bytes as unsigned, as std::string does
+  friend
+  bool operator<(const string_ref& x, const string_ref& y) {
+    size_t n = std::min(x.n, y.n);
+    int c = n ? memcmp(x.first, y.first, n) : 0;
+    return c < 0 || (c == 0 && x.n < y.n);
+  }
+
+  friend
+  bool operator>(const string_ref& x, const string_ref& y) {
+    return y < x;
+  }
+
+  friend
+  bool operator<=(const string_ref& x, const string_ref& y) {
+    return !(y < x);
+  }
+
+  friend
+  bool operator>=(const string_ref& x, const string_ref& y) {
+    return !(x < y);
+  }
+
+  friend
+  std::ostream& operator<<(std::ostream& out, const string_ref& x) {
+    return out.write(x.first, std::streamsize(x.n));
+  }
+  friend
+  bool points_into(const string_ref& x, const uint8_t* first, const uint8_t* last) {
+    return (const uint8_t*)x.first >= first && (const uint8_t*)x.first < last;
+  }
+};
+
+struct string_descriptor {
+  typedef string_ref value_type;
+  enum { equality_preserving = true };
+  enum { order_preserving = false };
+  enum { prefixed_size = true };
+  typedef std::forward_iterator_tag iterator_category;
+
+  vbyte_descriptor length;
+
+  uint8_t* encode(const value_type& x, uint8_t* dst) const {
+    dst = length.encode(x.size(), dst);
+    if (x.size()) memcpy(dst, x.data(), x.size());
+    return dst + x.size();
+  }
+
+  size_t encoded_size(const value_type& x) const {
+    return length.encoded_size(x.size()) + x.size();
+  }
+
+  // the returned string_ref refers to the bytes at p
+  value_type decode(const uint8_t* p) const {
+    std::pair<uint64_t, size_t> a = length.attributes(p);
+    return value_type((const char*)p + a.second, size_t(a.first));
+  }
+
+  size_t size(const uint8_t* p) const {
+    std::pair<uint64_t, size_t> a = length.attributes(p);
+    return a.second + size_t(a.first);
+  }
+
+  std::pair<const uint8_t*, uint8_t*>
+  copy(const uint8_t* src, uint8_t* dst) const {
+    size_t n = size(src);
+    memcpy(dst, src, n);
+    return std::make_pair(src + n, dst + n);
+  }
+};
+
+struct ordered_string_descriptor {
+  typedef std::string value_type;
+  enum { equality_preserving = true };
+  enum { order_preserving = true };
+  enum { prefixed_size = false };
+  typedef std::bidirectional_iterator_tag iterator_category;
+
+  enum { escape = 0x00, terminator = 0x01, escaped_zero = 0xff };
+
+  uint8_t* encode(const value_type& x, uint8_t* dst) const {
+    for (size_t i = 0; i < x.size(); ++i) {
+      uint8_t c = uint8_t(x[i]);
+      *dst++ = c;
+      if (c == escape) *dst++ = escaped_zero;
+    }
+    *dst++ = escape;
+    *dst++ = terminator;
+    return dst;
+  }
+
+  size_t encoded_size(const value_type& x) const {
+    return x.size() + size_t(std::count(x.begin(), x.end(), char(escape))) + 2;
+  }
+
+  // returns the position of the terminator of the datum starting at p
+  static
+  const uint8_t* find_terminator(const uint8_t* p) {
+    while (true) {
+      while (*p != escape) ++p;
+      if (p[1] == terminator) return p;
+      p += 2;
+    }
+  }
+
+  std::pair<value_type, size_t> attributes(const uint8_t* p) const {
+    const uint8_t* first = p;
+    value_type result;
+    while (true) {
+      const uint8_t* zero = p;
+      while (*zero != escape) ++zero;
+      result.append((const char*)p, zero - p);
+      if (zero[1] == terminator) return std::make_pair(result, size_t(zero + 2 - first));
+      result.push_back(char(escape));
+      p = zero + 2;
+    }
+  }
+
+  value_type decode(const uint8_t* p) const {
+    return attributes(p).first;
+  }
+
+  size_t size(const uint8_t* p) const {
+    return find_terminator(p) + 2 - p;
+  }
+
+  // the datum before current ends with the terminator at current - 2 and
+  // starts after the terminator before it, or at origin
+  const uint8_t* previous(const uint8_t* origin,
+                          const uint8_t* current) const {
+    if (current == origin) return current;
+    current -= 2;
+    while (current != origin) {
+      if (current[-1] == terminator && current - origin >= 2 && current[-2] == escape) return current;
+      --current;
+    }
+    return current;
+  }
+
+  std::pair<value_type, size_t> attributes_backward(const uint8_t* origin,
+                                                    const uint8_t* current) const {
+    if (current == origin) return std::make_pair(value_type(), size_t(0));
+    const uint8_t* p = previous(origin, current);
+    return std::make_pair(decode(p), size_t(current - p));
+  }
+
+  std::pair<const uint8_t*, uint8_t*>
+  copy(const uint8_t* src, uint8_t* dst) const {
+    size_t n = size(src);
+    memcpy(dst, src, n);
+    return std::make_pair(src + n, dst + n);
+  }
+};
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 2
+// indent-tabs-mode: nil
+// End:
+#endif
@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <algorithm>
+#include <utility>
 #include <new>
 
 #include "extent.h"
@@ -63,6 +64,15 @@ public:
   std::pair<const_iterator, const_iterator>
   insert(const_iterator position, InputIterator first, InputIterator last);
 
+  template <typename InputIterator>
+  void append(InputIterator first, InputIterator last);
+
+  template <typename T>
+  T* decode_into(T* result, size_type n) const;
+
+  template <typename T>
+  size_type decode_block(const_iterator& cursor, T* result, size_type n) const;
+
   const_iterator erase(const_iterator first, const_iterator last);
 
   ~tape();
@@ -114,12 +124,19 @@ time complexity when arrays are nested." (EoP page 220)
 
 It is especially important for the tape since in many cases they are
 contained in a sparse vector.  This is one of the reasons that we do
-not store the allocator in the header but use malloc.
+not store the allocator in the header: the allocator is a policy with
+static member functions (see extent.h), malloc_allocator by default.
+The growth policy chooses the capacity when the extent is reallocated.
+Extent is extent, or small_extent (small_extent.h) to keep tapes of up to
+14 bytes inside the tape object.
 */
 
 
 
-template <typename WritableVariableSizeTypeDescriptor>
+template <typename WritableVariableSizeTypeDescriptor,
+          typename Allocator = malloc_allocator,
+          typename Growth = doubling_growth,
+          template <typename, typename, typename, typename> class Extent = extent>
 class tape {
 public:
   typedef WritableVariableSizeTypeDescriptor descriptor_type;
@@ -135,6 +152,8 @@ public:
   typedef const_iterator iterator;
   typedef typename const_iterator::difference_type difference_type;
   typedef size_t  size_type;
+  typedef Allocator allocator_type;
+  typedef Growth growth_policy;
 
 private:
   typedef uint8_t* pointer;
@@ -146,15 +165,19 @@ private:
     size_t number_of_elements;
   };
 
-  extent<tape_metadata> ext;
+  Extent<tape_metadata, byte_copier, allocator_type, growth_policy> ext;
   descriptor_type dsc;
 
-  size_type& number_of_elements() { // only safe when non-empty
-    return ext.metadata()->number_of_elements;
+  // an extent without metadata (an inline small_extent) does not count
+  void set_size(size_type n) {
+    tape_metadata* m = ext.metadata();
+    if (m) m->number_of_elements = n;
   }
 
-  const size_type& number_of_elements() const { // only safe when non-empty
-    return ext.metadata()->number_of_elements;
+  // returns the number of values if it is to be recorded after inserting
+  // n bytes, 0 otherwise
+  size_type size_to_record(size_t n) const {
+    return ext.metadata() || ext.remaining_byte_capacity() < n ? size() : size_type(0);
   }
 
   struct back_insert_iterator_basis {
@@ -177,9 +200,18 @@ private:
     };
 
     void store(const value_type& value) {
-      tape_p->ext.insert_space(tape_p->dsc.encoded_size(value),
-                               writer(value, tape_p->dsc));
-      ++tape_p->number_of_elements();
+      const uint8_t* first = tape_p->get_extent().storage();
+      if (first && points_into(value, first, tape_p->get_extent().content_end())) {
+        // the value refers to bytes that inserting may move or free
+        tape tmp(tape_p->dsc);
+        tmp.push_back(value);
+        tape_p->append(tmp.begin(), tmp.end());
+        return;
+      }
+      size_t bytes = tape_p->dsc.encoded_size(value);
+      size_type n = tape_p->size_to_record(bytes);
+      tape_p->ext.insert_space(bytes, writer(value, tape_p->dsc));
+      tape_p->set_size(n + 1);
     }
   };
 
@@ -194,12 +226,18 @@ private:
   }
 
 public:
-  const extent<tape_metadata>& get_extent() const { return ext; }
+  typedef Extent<tape_metadata, byte_copier, allocator_type, growth_policy> extent_type;
+
+  const extent_type& get_extent() const { return ext; }
 
   bool empty() const { return get_extent().empty(); }
 
   // returns the number of values currently stored in the tape
-  size_type size() const { return empty() ? size_type(0) : number_of_elements(); }
+  size_type size() const {
+    if (empty()) return size_type(0);
+    const tape_metadata* m = ext.metadata();
+    return m ? m->number_of_elements : size_type(std::distance(begin(), end()));
+  }
 
   // returns (a conservative estimate of) the number of values the tape can hold
   // without reallocation
@@ -219,6 +257,27 @@ public:
     return const_iterator(iterator_state(p, p + get_extent().byte_size(), dsc));
   }
 
+  // decodes the first values of the tape, at most n, into result with the
+  // bulk kernel of the descriptor (see decode_n in variable_size_type.h);
+  // returns the position following the last written value
+  template <typename T>
+  T* decode_into(T* result, size_type n) const {
+    return decode_n(get_extent().storage(), get_extent().content_end(), n, result, dsc).second;
+  }
+
+  // decodes at most n values starting at cursor into result and advances
+  // cursor past them, so that a tape can be streamed through a small
+  // buffer; returns the number of values written, which is 0 only at end()
+  // if n is at least the number of values of a datum (block_capacity for
+  // a block descriptor)
+  template <typename T>
+  size_type decode_block(const_iterator& cursor, T* result, size_type n) const {
+    std::pair<const_pointer, T*> p =
+      decode_n(pos(cursor), get_extent().content_end(), n, result, dsc);
+    cursor = const_iterator(iterator_state(get_extent().storage(), p.first, dsc));
+    return size_type(p.second - result);
+  }
+
   friend
   inline
   bool operator==(const tape& x, const tape& y) {
@@ -287,9 +346,11 @@ private:
   std::pair<const_iterator, const_iterator>
   insert(const_iterator position, InputIterator first, InputIterator last,
          std::input_iterator_tag) {
-    size_type insertion_offset(pos(position) - ext.storage());
+    // the const storage, since the non-const one may copy the block (see
+    // shared_extent.h) and leave position in the old one
+    size_type insertion_offset(pos(position) - get_extent().storage());
     size_type old_byte_size(get_extent().byte_size());
-    std::copy(first, last, back_inserter()); // might reallocate and invalidate position
+    append(first, last, std::input_iterator_tag()); // might reallocate and invalidate position
     pointer begin_inserted_range = ext.storage() + insertion_offset;
     size_t increment = get_extent().byte_size() - old_byte_size;
     pointer end_inserted_range = begin_inserted_range + increment;
@@ -306,8 +367,7 @@ private:
       : first(first), last(last), dsc(dsc) {}
     template <typename T>
     void write(pointer p, T) {
-      output_iterator result(output_iterator_state(p, dsc));
-      std::copy(first, last, result);
+      encode_range(first, last, p, dsc);
     }
     void write(pointer p, const_iterator) {
       std::copy(pos(first), pos(last), p);
@@ -333,33 +393,72 @@ private:
          ForwardIterator first, ForwardIterator last,
          std::forward_iterator_tag) {
     std::pair<size_type, size_type>  size_and_count = size_count(first, last);
+    size_type n = size_to_record(size_and_count.first);
     pointer insert_position = pos_non_const(position);
     writer<ForwardIterator> w(first, last, dsc);
     pointer begin_inserted = ext.insert_space(insert_position, size_and_count.first, w);
     pointer end_inserted = begin_inserted + size_and_count.first;
-    if (size_and_count.second) number_of_elements() += size_and_count.second;
+    if (size_and_count.second) set_size(n + size_and_count.second);
     return inserted_range(begin_inserted, end_inserted);
   }
 
+  // the values of an input range are copied, as values of the value type
+  // of the iterator, into a buffer of about 8KB, and appended a buffer at
+  // a time
+  template <typename InputIterator>
+  void append(InputIterator first, InputIterator last, std::input_iterator_tag) {
+    typedef typename std::iterator_traits<InputIterator>::value_type T;
+    T buffer[(8192 + sizeof(T) - 1) / sizeof(T)];
+    T* buffer_last = buffer + sizeof(buffer) / sizeof(T);
+    while (first != last) {
+      T* p = buffer;
+      while (first != last && p != buffer_last) *p++ = *first++;
+      append(buffer, p, std::forward_iterator_tag());
+    }
+  }
+
+  template <typename ForwardIterator>
+  void append(ForwardIterator first, ForwardIterator last, std::forward_iterator_tag) {
+    std::pair<size_type, size_type> size_and_count = size_count(first, last);
+    size_type n = size_to_record(size_and_count.first);
+    ext.insert_space(size_and_count.first, writer<ForwardIterator>(first, last, dsc));
+    if (size_and_count.second) set_size(n + size_and_count.second);
+  }
+
 public:
 
   void adjust_byte_capacity(size_type n) {
+    // a small_extent that moves its bytes to a block starts counting there
+    size_type count = size_to_record(n);
     ext.adjust_byte_capacity(n);
+    set_size(count);
   }
 
   template <typename InputIterator>
   std::pair<const_iterator, const_iterator>
   insert(const_iterator position, InputIterator first, InputIterator last) {
     typename std::iterator_traits<InputIterator>::iterator_category tag;
-    return insert(position, first, last, tag);
+    return insert(position, unwrap_iterator(first), unwrap_iterator(last), tag);
+  }
+
+  // appends the values of [first, last), computing their size and
+  // allocating once for a forward range, and once per buffer of values
+  // for an input range
+  template <typename InputIterator>
+  void append(InputIterator first, InputIterator last) {
+    typename std::iterator_traits<InputIterator>::iterator_category tag;
+    append(unwrap_iterator(first), unwrap_iterator(last), tag);
   }
 
   const_iterator erase(const_iterator first, const_iterator last) {
     size_t number_of_erased_elements = size_t(std::distance(first, last));
     size_t size_of_erased_elements = pos(last) - pos(first);
-    if (ext.erase_space(pos_non_const(first), size_of_erased_elements)) {
-      number_of_elements() -= number_of_erased_elements;
-      return first;
+    size_type n = size_to_record(0);
+    pointer p = ext.erase_space(pos_non_const(first), size_of_erased_elements);
+    if (p) {
+      set_size(n - number_of_erased_elements);
+      // the extent may have moved the bytes to another block
+      return const_iterator(iterator_state(ext.storage(), p, dsc));
     } else {
       return const_iterator();
     }
@@ -375,9 +474,25 @@ public:
     insert(end(), first, last);
   }
 
+#if __cplusplus >= 201103L
+  tape(const tape&) = default;
+
+  tape& operator=(const tape&) = default;
+
+  // leaves x empty
+  tape(tape&& x) noexcept : ext(std::move(x.ext)), dsc(x.dsc) {}
+
+  tape& operator=(tape&& x) noexcept {
+    ext = std::move(x.ext);
+    dsc = x.dsc;
+    return *this;
+  }
+#endif
+
   friend
   void swap(tape& x, tape& y) {
-    std::swap(x.ext, y.ext);
+    swap(x.ext, y.ext);
+    std::swap(x.dsc, y.dsc);
   }
 
 };
@@ -0,0 +1,281 @@
+#ifndef TAPE_OF_TAPES_H
+#define TAPE_OF_TAPES_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <string.h>
+#include <iterator>
+#include <algorithm>
+#include <utility>
+
+#include "variable_size_type.h"
+#include "vbyte_descriptor.h"
+#include "tape.h"
+
+/*
+
+tape_of_tapes stores a sequence of tapes one after another in a single
+extent, so that a posting list whose documents carry lists of positions
+is one allocation instead of one extent per document.  Every sub-tape is
+stored as
+
+  vbyte number of values | vbyte number of bytes | the bytes of the tape
+
+and is given back as a tape_view: the position and size of the bytes of
+the sub-tape together with its descriptor, with the iterators of
+tape<VariableSizeTypeDescriptor>.  A tape_view refers to the bytes inside
+the tape of tapes and is valid as long as it is not modified; pushing it
+back into the same tape of tapes copies its bytes first.
+
+nested_tape_descriptor is the descriptor of the sub-tapes; tape_of_tapes
+is tape<nested_tape_descriptor<D> > with the interface of a container of
+tapes.  Since the encoding copies the bytes of a sub-tape, it is
+equality preserving if the descriptor of the sub-tapes is.
+
+*/
+
+// refers to the bytes of a tape stored elsewhere
+
+template <typename VariableSizeTypeDescriptor>
+struct tape_view {
+  typedef VariableSizeTypeDescriptor descriptor_type;
+  typedef tape<descriptor_type> tape_type;
+  typedef typename tape_type::value_type value_type;
+  typedef typename tape_type::iterator_state iterator_state;
+  typedef typename tape_type::const_iterator const_iterator;
+  typedef const_iterator iterator;
+  typedef typename tape_type::difference_type difference_type;
+  typedef size_t size_type;
+
+  const uint8_t* first;
+  const uint8_t* last;
+  size_type n;
+  descriptor_type dsc;
+
+  tape_view() : first(NULL), last(NULL), n(0) {}
+
+  tape_view(const uint8_t* first, const uint8_t* last, size_type n,
+            const descriptor_type& dsc = descriptor_type())
+    : first(first), last(last), n(n), dsc(dsc) {}
+
+  tape_view(const tape_type& x)
+    : first(x.get_extent().storage()), last(x.get_extent().content_end()),
+      n(x.size()), dsc(x.descriptor()) {}
+
+  size_type size() const { return n; }
+
+  bool empty() const { return n == 0; }
+
+  size_type byte_size() const { return size_type(last - first); }
+
+  descriptor_type descriptor() const { return dsc; }
+
+  const_iterator begin() const {
+    return const_iterator(iterator_state(first, first, dsc));
+  }
+
+  const_iterator end() const {
+    return const_iterator(iterator_state(first, last, dsc));
+  }
+
+  // returns a tape with a copy of the values
+  tape_type to_tape() const { return tape_type(begin(), end(), dsc); }
+
+  friend
+  bool operator==(const tape_view& x, const tape_view& y) {
+    if (x.size() != y.size()) return false;
+    if (x.dsc.equality_preserving) {
+      return x.byte_size() == y.byte_size() && std::equal(x.first, x.last, y.first);
+    }
+    return std::equal(x.begin(), x.end(), y.begin());
+  }
+
+  friend
+  bool operator!=(const tape_view& x, const tape_view& y) {
+    return !(x == y);
+  }
+
+  friend
+  bool operator<(const tape_view& x, const tape_view& y) {
+    if (x.dsc.order_preserving) {
+      return std::lexicographical_compare(x.first, x.last, y.first, y.last);
+    }
+    return std::lexicographical_compare(x.begin(), x.end(), y.begin(), y.end());
+  }
+
+  friend
+  bool operator>(const tape_view& x, const tape_view& y) {
+    return y < x;
+  }
+
+  friend
+  bool operator<=(const tape_view& x, const tape_view& y) {
+    return !(y < x);
+  }
+
+  friend
+  bool operator>=(const tape_view& x, const tape_view& y) {
+    return !(x < y);
+  }
+  friend
+  bool points_into(const tape_view& x, const uint8_t* first, const uint8_t* last) {
+    return x.first >= first && x.first < last;
+  }
+};
+
+
+template <typename WritableVariableSizeTypeDescriptor>
+struct nested_tape_descriptor {
+  typedef WritableVariableSizeTypeDescriptor element_descriptor;
+  typedef tape_view<element_descriptor> value_type;
+  enum { equality_preserving = element_descriptor::equality_preserving };
+  enum { order_preserving = false };
+  enum { prefixed_size = true };
+  typedef std::forward_iterator_tag iterator_category;
+
+  vbyte_descriptor header;
+  element_descriptor element;
+
+  nested_tape_descriptor(const element_descriptor& element = element_descriptor())
+    : element(element) {}
+
+  uint8_t* encode(const value_type& x, uint8_t* dst) const {
+    dst = header.encode(x.size(), dst);
+    dst = header.encode(x.byte_size(), dst);
+    if (x.byte_size()) memcpy(dst, x.first, x.byte_size());
+    return dst + x.byte_size();
+  }
+
+  size_t encoded_size(const value_type& x) const {
+    return header.encoded_size(x.size()) + header.encoded_size(x.byte_size()) +
+      x.byte_size();
+  }
+
+  // the returned view refers to the bytes at p
+  value_type decode(const uint8_t* p) const {
+    std::pair<uint64_t, size_t> n = header.attributes(p);
+    p += n.second;
+    std::pair<uint64_t, size_t> bytes = header.attributes(p);
+    p += bytes.second;
+    return value_type(p, p + size_t(bytes.first), size_t(n.first), element);
+  }
+
+  size_t size(const uint8_t* p) const {
+    const uint8_t* q = p + header.size(p);
+    std::pair<uint64_t, size_t> bytes = header.attributes(q);
+    return size_t(q - p) + bytes.second + size_t(bytes.first);
+  }
+
+  std::pair<const uint8_t*, uint8_t*>
+  copy(const uint8_t* src, uint8_t* dst) const {
+    size_t n = size(src);
+    memcpy(dst, src, n);
+    return std::make_pair(src + n, dst + n);
+  }
+};
+
+
+template <typename WritableVariableSizeTypeDescriptor>
+class tape_of_tapes {
+public:
+  typedef WritableVariableSizeTypeDescriptor element_descriptor;
+  typedef nested_tape_descriptor<element_descriptor> descriptor_type;
+  typedef tape<descriptor_type> nested_tape;
+  typedef tape<element_descriptor> tape_type;
+  typedef tape_view<element_descriptor> value_type;
+  typedef value_type reference;
+  typedef value_type const_reference;
+  typedef typename nested_tape::const_iterator const_iterator;
+  typedef const_iterator iterator;
+  typedef typename nested_tape::difference_type difference_type;
+  typedef size_t size_type;
+
+private:
+  nested_tape tapes;
+
+public:
+  const nested_tape& get_tapes() const { return tapes; }
+
+  bool empty() const { return tapes.empty(); }
+
+  // returns the number of sub-tapes
+  size_type size() const { return tapes.size(); }
+
+  // returns the size in bytes of the single extent holding all the sub-tapes
+  size_type byte_size() const { return tapes.get_extent().byte_size(); }
+
+  descriptor_type descriptor() const { return tapes.descriptor(); }
+
+  const_iterator begin() const { return tapes.begin(); }
+
+  const_iterator end() const { return tapes.end(); }
+
+  // appends a copy of the bytes of x; x may also be a tape_type
+  void push_back(const value_type& x) { tapes.push_back(x); }
+
+  // appends a sub-tape holding the values of [first, last)
+  template <typename InputIterator>
+  void push_back(InputIterator first, InputIterator last) {
+    push_back(tape_type(first, last, descriptor().element));
+  }
+
+  // appends the tapes of [first, last)
+  template <typename InputIterator>
+  void append(InputIterator first, InputIterator last) {
+    tapes.insert(tapes.end(), first, last);
+  }
+
+  void adjust_byte_capacity(size_type n) { tapes.adjust_byte_capacity(n); }
+
+  tape_of_tapes(const element_descriptor& dsc = element_descriptor())
+    : tapes(descriptor_type(dsc)) {}
+
+  template <typename InputIterator>
+  tape_of_tapes(InputIterator first, InputIterator last,
+                const element_descriptor& dsc = element_descriptor())
+    : tapes(descriptor_type(dsc)) {
+    append(first, last);
+  }
+
+  friend
+  bool operator==(const tape_of_tapes& x, const tape_of_tapes& y) {
+    return x.tapes == y.tapes;
+  }
+
+  friend
+  bool operator!=(const tape_of_tapes& x, const tape_of_tapes& y) {
+    return !(x == y);
+  }
+
+  friend
+  bool operator<(const tape_of_tapes& x, const tape_of_tapes& y) {
+    return x.tapes < y.tapes;
+  }
+
+  friend
+  bool operator>(const tape_of_tapes& x, const tape_of_tapes& y) {
+    return y < x;
+  }
+
+  friend
+  bool operator<=(const tape_of_tapes& x, const tape_of_tapes& y) {
+    return !(y < x);
+  }
+
+  friend
+  bool operator>=(const tape_of_tapes& x, const tape_of_tapes& y) {
+    return !(x < y);
+  }
+
+  friend
+  void swap(tape_of_tapes& x, tape_of_tapes& y) {
+    swap(x.tapes, y.tapes);
+  }
+};
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 2
+// indent-tabs-mode: nil
+// End:
+#endif
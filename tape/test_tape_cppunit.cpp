@@ -6,13 +6,41 @@
 
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 #include <iostream>
+#include <sstream>
+#include <iterator>
 #include <limits>
 #include <list>
+#include <set>
+#include <string>
 #include <algorithm>
 #include <numeric>
+#if __cplusplus >= 201103L
+#include <type_traits>
+#endif
 
 #include "vbyte_descriptor.h"
+#include "stream_vbyte_descriptor.h"
+#include "group_varint_descriptor.h"
+#include "pfor_descriptor.h"
+#include "elias_fano.h"
+#include "ordered_integer_descriptor.h"
+#include "zigzag_descriptor.h"
+#include "delta_tape.h"
+#include "gorilla_descriptor.h"
+#include "string_descriptor.h"
+#include "fixed_width_descriptor.h"
+#include "adaptive_descriptor.h"
+#include "transcode.h"
+#include "tape_of_tapes.h"
+#include "cpu_dispatch.h"
+#include "hybrid_set.h"
+#include "allocation_policy.h"
+#include "small_extent.h"
+#include "shared_extent.h"
+#include "segmented_tape.h"
+#include "gap_buffer_tape.h"
 #include "tape.h"
 #include "statistic.h"
 
@@ -45,6 +73,32 @@ public:
   void testErase();
   void testAdjustByteCapacity();
   void testIterators();
+  void testBulkDecode();
+  void testStreamVByte();
+  void testGroupVarint();
+  void testBitPacking();
+  void testPFor();
+  void testEliasFano();
+  void testOrderedInteger();
+  void testZigZag();
+  void testDeltaTape();
+  void testGorilla();
+  void testStrings();
+  void testFixedWidth();
+  void testAdaptive();
+  void testTranscode();
+  void testTapeOfTapes();
+  void testCpuDispatch();
+  void testHybridSet();
+  void testAllocationPolicy();
+  void testGrowthPolicy();
+  void testSmallExtent();
+  void testMoveSemantics();
+  void testSharedExtent();
+  void testAppend();
+  void testDecodeBlock();
+  void testSegmentedTape();
+  void testGapBufferTape();
 
   CPPUNIT_TEST_SUITE( TapeTest );
   CPPUNIT_TEST( testConstructionFromRange );
@@ -63,6 +117,32 @@ public:
   CPPUNIT_TEST( testErase );
   CPPUNIT_TEST( testAdjustByteCapacity );
   CPPUNIT_TEST( testIterators );
+  CPPUNIT_TEST( testBulkDecode );
+  CPPUNIT_TEST( testStreamVByte );
+  CPPUNIT_TEST( testGroupVarint );
+  CPPUNIT_TEST( testBitPacking );
+  CPPUNIT_TEST( testPFor );
+  CPPUNIT_TEST( testEliasFano );
+  CPPUNIT_TEST( testOrderedInteger );
+  CPPUNIT_TEST( testZigZag );
+  CPPUNIT_TEST( testDeltaTape );
+  CPPUNIT_TEST( testGorilla );
+  CPPUNIT_TEST( testStrings );
+  CPPUNIT_TEST( testFixedWidth );
+  CPPUNIT_TEST( testAdaptive );
+  CPPUNIT_TEST( testTranscode );
+  CPPUNIT_TEST( testTapeOfTapes );
+  CPPUNIT_TEST( testCpuDispatch );
+  CPPUNIT_TEST( testHybridSet );
+  CPPUNIT_TEST( testAllocationPolicy );
+  CPPUNIT_TEST( testGrowthPolicy );
+  CPPUNIT_TEST( testSmallExtent );
+  CPPUNIT_TEST( testMoveSemantics );
+  CPPUNIT_TEST( testSharedExtent );
+  CPPUNIT_TEST( testAppend );
+  CPPUNIT_TEST( testDecodeBlock );
+  CPPUNIT_TEST( testSegmentedTape );
+  CPPUNIT_TEST( testGapBufferTape );
   CPPUNIT_TEST_SUITE_END();
 
 };
@@ -319,6 +399,1502 @@ void TapeTest::testIterators() {
   CPPUNIT_ASSERT( std::equal(vbytes2.begin(), vbytes2.end(), v.begin()) );
 }
 
+void TapeTest::testBulkDecode() {
+  // differential test of the bulk kernels against decode
+  std::vector<uint64_t> v;
+  zipf z(std::numeric_limits<uint32_t>::max());
+  for (int i = 1; i <= 100000; ++i) {
+    if (i % 1000 < 100) v.push_back(uint64_t(i % 100));  // runs of one-byte values
+    else if (i % 97 == 0) v.push_back(uint64_t(lrand48()) << 32 | uint64_t(lrand48()));
+    else v.push_back(z.random());
+  }
+  v.push_back(std::numeric_limits<uint64_t>::max());
+  vbyte_tape vbytes1(v.begin(), v.end());
+  const uint8_t* first = vbytes1.get_extent().storage();
+  const uint8_t* last = vbytes1.get_extent().content_end();
+  vbyte_descriptor dsc;
+
+  std::vector<uint64_t> expected;
+  for (const uint8_t* p = first; p != last; p += dsc.size(p)) {
+    expected.push_back(dsc.decode(p));
+  }
+  CPPUNIT_ASSERT( expected == v );
+
+  // the result has room for n values, even when the range holds fewer
+  // (the last chunk below asks for 7 values, of which fewer remain)
+  std::vector<uint64_t> decoded(v.size() + 7);
+  std::pair<const uint8_t*, uint64_t*> r = decode_n(first, last, v.size() + 1, &decoded[0], dsc);
+  CPPUNIT_ASSERT( r.first == last && r.second == &decoded[0] + v.size() );
+  CPPUNIT_ASSERT( std::equal(v.begin(), v.end(), decoded.begin()) );
+
+  // resuming in small chunks gives the same sequence
+  std::fill(decoded.begin(), decoded.end(), uint64_t(0));
+  r = std::make_pair(first, &decoded[0]);
+  while (r.first != last) r = decode_n(r.first, last, 7, r.second, dsc);
+  CPPUNIT_ASSERT( r.second == &decoded[0] + v.size() );
+  CPPUNIT_ASSERT( std::equal(v.begin(), v.end(), decoded.begin()) );
+
+#ifdef VBYTE_WORD_KERNELS
+  // the portable kernel stops when less than a window of input or output remains
+  std::fill(decoded.begin(), decoded.end(), uint64_t(0));
+  uint64_t* result_last = &decoded[0] + v.size();
+  r = vbyte_decode_windows(first, last, &decoded[0], result_last,
+                           vbyte_continuation_mask_swar());
+  CPPUNIT_ASSERT( size_t(last - r.first) < 16 || size_t(result_last - r.second) < 8 );
+  CPPUNIT_ASSERT( std::equal(&decoded[0], r.second, v.begin()) );
+#endif
+}
+
+void TapeTest::testStreamVByte() {
+  typedef tape<stream_vbyte_descriptor> stream_vbyte_tape;
+  std::vector<uint32_t> v;
+  zipf z(std::numeric_limits<uint32_t>::max());
+  for (int i = 1; i <= 100003; ++i) {  // the last block is partial
+    v.push_back(i % 5 == 0 ? uint32_t(lrand48()) : uint32_t(z.random()));
+  }
+  v.push_back(std::numeric_limits<uint32_t>::max());
+
+  stream_vbyte_tape blocks;
+  append_blocks(blocks, v.begin(), v.end());
+  CPPUNIT_ASSERT( blocks.size() == (v.size() + 127) / 128 );
+  CPPUNIT_ASSERT( std::equal(v.begin(), v.end(), element_iterator(blocks.begin())) );
+  CPPUNIT_ASSERT( std::distance(element_iterator(blocks.begin()),
+                                element_iterator(blocks.end())) == ptrdiff_t(v.size()) );
+
+  // empty blocks are skipped when the end of the blocks is given
+  stream_vbyte_tape sparse;
+  sparse.push_back(stream_vbyte_descriptor::value_type());
+  append_blocks(sparse, v.begin(), v.begin() + 200);
+  sparse.push_back(stream_vbyte_descriptor::value_type());
+  sparse.push_back(stream_vbyte_descriptor::value_type());
+  append_blocks(sparse, v.begin() + 200, v.end());
+  sparse.push_back(stream_vbyte_descriptor::value_type());
+  CPPUNIT_ASSERT( sparse.size() == blocks.size() + 4 );
+  CPPUNIT_ASSERT( std::equal(v.begin(), v.end(), element_iterator(sparse.begin(), sparse.end())) );
+  CPPUNIT_ASSERT( std::distance(element_iterator(sparse.begin(), sparse.end()),
+                                element_iterator(sparse.end())) == ptrdiff_t(v.size()) );
+  stream_vbyte_tape only_empty;
+  only_empty.push_back(stream_vbyte_descriptor::value_type());
+  CPPUNIT_ASSERT( element_iterator(only_empty.begin(), only_empty.end()) ==
+                  element_iterator(only_empty.end()) );
+
+  stream_vbyte_descriptor dsc;
+  stream_vbyte_tape::const_iterator i = blocks.begin();
+  stream_vbyte_descriptor::value_type block = *i;
+  CPPUNIT_ASSERT( dsc.size(i.state().position) == dsc.encoded_size(block) );
+
+  stream_vbyte_tape blocks1(blocks);
+  CPPUNIT_ASSERT( blocks1 == blocks );
+  blocks1.erase(blocks1.begin(), ++blocks1.begin());
+  CPPUNIT_ASSERT( blocks1 != blocks );
+  CPPUNIT_ASSERT( std::equal(blocks1.begin(), blocks1.end(), ++blocks.begin()) );
+}
+
+void TapeTest::testGroupVarint() {
+  typedef tape<group_varint_descriptor> group_varint_tape;
+  std::vector<uint32_t> v;
+  zipf z(std::numeric_limits<uint32_t>::max());
+  for (int i = 1; i <= 100002; ++i) {  // the last group is partial
+    v.push_back(i % 5 == 0 ? uint32_t(lrand48()) : uint32_t(z.random()));
+  }
+  v.push_back(0);
+  v.push_back(std::numeric_limits<uint32_t>::max());
+
+  group_varint_tape groups;
+  append_blocks(groups, v.begin(), v.end());
+  CPPUNIT_ASSERT( groups.size() == (v.size() + 3) / 4 );
+  CPPUNIT_ASSERT( std::equal(v.begin(), v.end(), element_iterator(groups.begin())) );
+
+  // backward iteration visits the same groups
+  std::list<group_varint_descriptor::value_type> reversed;
+  group_varint_tape::const_iterator i = groups.end();
+  while (i != groups.begin()) reversed.push_front(*--i);
+  CPPUNIT_ASSERT( std::equal(groups.begin(), groups.end(), reversed.begin()) );
+
+  // room for the 6 values asked by the last chunk below
+  std::vector<uint32_t> decoded(v.size() + 6);
+  const uint8_t* first = groups.get_extent().storage();
+  const uint8_t* last = groups.get_extent().content_end();
+  std::pair<const uint8_t*, uint32_t*> r = decode_n(first, last, v.size(), &decoded[0],
+                                                    group_varint_descriptor());
+  CPPUNIT_ASSERT( r.first == last && r.second == &decoded[0] + v.size() );
+  CPPUNIT_ASSERT( std::equal(v.begin(), v.end(), decoded.begin()) );
+
+  // a group is never split between calls
+  std::fill(decoded.begin(), decoded.end(), uint32_t(0));
+  r = std::make_pair(first, &decoded[0]);
+  while (r.first != last) {
+    uint32_t* previous = r.second;
+    r = decode_n(r.first, last, 6, r.second, group_varint_descriptor());
+    CPPUNIT_ASSERT( r.second - previous == 4 || r.first == last );
+  }
+  CPPUNIT_ASSERT( r.second == &decoded[0] + v.size() );
+  CPPUNIT_ASSERT( std::equal(v.begin(), v.end(), decoded.begin()) );
+}
+
+void TapeTest::testBitPacking() {
+  uint32_t values[133];
+  uint32_t unpacked[133];
+  uint8_t packed[133 * 4 + 8];
+  for (unsigned b = 0; b <= 32; ++b) {
+    uint64_t mask = (uint64_t(1) << b) - 1;
+    for (size_t i = 0; i < 133; ++i) values[i] = uint32_t(mrand48() & mask);
+    for (size_t n = 0; n <= 133; n += 19) {
+      uint8_t* end = pack_bits(values, n, b, packed);
+      CPPUNIT_ASSERT( size_t(end - packed) == packed_size(n, b) );
+      CPPUNIT_ASSERT( unpack_bits(packed, n, b, unpacked) == end );
+      CPPUNIT_ASSERT( std::equal(values, values + n, unpacked) );
+    }
+  }
+}
+
+void TapeTest::testPFor() {
+  typedef tape<pfor_descriptor> pfor_tape;
+  std::vector<uint32_t> v;
+  exponential e(16.0);
+  for (int i = 1; i <= 100001; ++i) {  // small gaps with rare outliers
+    v.push_back(i % 50 == 0 ? uint32_t(lrand48()) : uint32_t(e.random()));
+  }
+  v.push_back(std::numeric_limits<uint32_t>::max());
+
+  pfor_tape blocks;
+  append_blocks(blocks, v.begin(), v.end());
+  CPPUNIT_ASSERT( std::equal(v.begin(), v.end(), element_iterator(blocks.begin())) );
+
+  vbyte_tape vbytes1(v.begin(), v.end());
+  CPPUNIT_ASSERT( blocks.get_extent().byte_size() < vbytes1.get_extent().byte_size() );
+
+  std::vector<uint32_t> decoded(v.size());
+  const uint8_t* first = blocks.get_extent().storage();
+  const uint8_t* last = blocks.get_extent().content_end();
+  std::pair<const uint8_t*, uint32_t*> r = decode_n(first, last, v.size(), &decoded[0],
+                                                    pfor_descriptor());
+  CPPUNIT_ASSERT( r.first == last && r.second == &decoded[0] + v.size() );
+  CPPUNIT_ASSERT( decoded == v );
+
+  // a block of zeros takes only the header
+  std::vector<uint32_t> zeros(128, 0);
+  pfor_tape zero_blocks;
+  append_blocks(zero_blocks, zeros.begin(), zeros.end());
+  CPPUNIT_ASSERT( zero_blocks.get_extent().byte_size() == size_t(pfor_descriptor::header_size) );
+  CPPUNIT_ASSERT( std::equal(zeros.begin(), zeros.end(), element_iterator(zero_blocks.begin())) );
+}
+
+void TapeTest::testEliasFano() {
+  std::vector<uint64_t> v;
+  uint64_t x(0);
+  zipf z(1000);
+  for (int i = 0; i < 100000; ++i) {
+    v.push_back(x);
+    if (i % 3) x += z.random();  // every third value is repeated
+  }
+  v.push_back(std::numeric_limits<uint64_t>::max());
+  elias_fano_sequence ef(v.begin(), v.end());
+  CPPUNIT_ASSERT( ef.size() == v.size() );
+  CPPUNIT_ASSERT( ef.byte_size() < v.size() * sizeof(uint64_t) );
+
+  for (size_t i = 0; i < v.size(); i += 7) CPPUNIT_ASSERT( ef.access(i) == v[i] );
+  CPPUNIT_ASSERT( std::equal(ef.begin(), ef.end(), v.begin()) );
+  CPPUNIT_ASSERT( ef.end() - ef.begin() == ptrdiff_t(v.size()) );
+
+  // backward and random access iteration
+  elias_fano_sequence::const_iterator i = ef.end();
+  std::vector<uint64_t>::iterator j = v.end();
+  while (i != ef.begin()) CPPUNIT_ASSERT( *--i == *--j );
+  CPPUNIT_ASSERT( *(ef.begin() + 4321) == v[4321] );
+  CPPUNIT_ASSERT( ef.begin()[99999] == v[99999] );
+
+  for (uint64_t y = 0; y < x + 10; y += 97) {
+    elias_fano_sequence::const_iterator k = ef.next_geq(y);
+    std::vector<uint64_t>::iterator m = std::lower_bound(v.begin(), v.end(), y);
+    CPPUNIT_ASSERT( k - ef.begin() == m - v.begin() );
+  }
+  CPPUNIT_ASSERT( std::lower_bound(ef.begin(), ef.end(), v[777]) == ef.next_geq(v[777]) );
+
+  // intersection with a sparser sequence
+  std::vector<uint64_t> w;
+  for (size_t k = 0; k < v.size(); k += 3) w.push_back(v[k] | 1);  // still non-decreasing
+  elias_fano_sequence ef2(w.begin(), w.end());
+  std::vector<uint64_t> expected, actual;
+  std::set_intersection(v.begin(), v.end(), w.begin(), w.end(), std::back_inserter(expected));
+  std::set_intersection(ef.begin(), ef.end(), ef2.begin(), ef2.end(), std::back_inserter(actual));
+  CPPUNIT_ASSERT( !expected.empty() && actual == expected );
+
+  elias_fano_sequence empty;
+  CPPUNIT_ASSERT( empty.begin() == empty.end() && empty.next_geq(0) == empty.end() );
+
+  // x >> l beyond every high part
+  uint64_t small_values[] = {1, 2, 3};
+  elias_fano_sequence ef3(small_values, small_values + 3);
+  CPPUNIT_ASSERT( ef3.next_geq(4) == ef3.end() );
+  CPPUNIT_ASSERT( ef3.next_geq(std::numeric_limits<uint64_t>::max()) == ef3.end() );
+  CPPUNIT_ASSERT( ef3.next_geq(3) - ef3.begin() == 2 );
+
+  // a single value of 64 bits makes l = 63
+  uint64_t huge[] = {uint64_t(1) << 63};
+  elias_fano_sequence ef4(huge, huge + 1);
+  CPPUNIT_ASSERT( ef4.size() == 1 && ef4.access(0) == huge[0] && *ef4.begin() == huge[0] );
+  CPPUNIT_ASSERT( ef4.next_geq(1) == ef4.begin() && ef4.next_geq(huge[0]) == ef4.begin() );
+  CPPUNIT_ASSERT( ef4.next_geq(huge[0] + 1) == ef4.end() );
+  CPPUNIT_ASSERT( ef4.next_geq(std::numeric_limits<uint64_t>::max()) == ef4.end() );
+}
+
+void TapeTest::testOrderedInteger() {
+  typedef tape<ordered_integer_descriptor> ordered_tape;
+  ordered_integer_descriptor dsc;
+  // values around every boundary between encoded sizes
+  std::vector<uint64_t> v;
+  v.push_back(0);
+  v.push_back(247);
+  v.push_back(248);
+  for (int shift = 8; shift < 64; shift += 8) {
+    v.push_back((uint64_t(1) << shift) - 1);
+    v.push_back(uint64_t(1) << shift);
+  }
+  v.push_back(std::numeric_limits<uint64_t>::max());
+  for (size_t i = 0; i < v.size(); ++i) {
+    uint8_t buffer[9];
+    CPPUNIT_ASSERT( dsc.encode(v[i], buffer) == buffer + dsc.encoded_size(v[i]) );
+    CPPUNIT_ASSERT( dsc.size(buffer) == dsc.encoded_size(v[i]) );
+    CPPUNIT_ASSERT( dsc.decode(buffer) == v[i] );
+  }
+  ordered_tape t(v.begin(), v.end());
+  CPPUNIT_ASSERT( std::equal(t.begin(), t.end(), v.begin()) );
+
+  // the bulk encoder of arrays writes the bytes of encode
+  std::vector<uint8_t> scalar;
+  for (size_t i = 0; i < v.size(); ++i) {
+    uint8_t buffer[9];
+    scalar.insert(scalar.end(), buffer, dsc.encode(v[i], buffer));
+  }
+  std::vector<uint8_t> bulk(scalar.size());
+  CPPUNIT_ASSERT( total_encoded_size(&v[0], &v[0] + v.size(), dsc).first == scalar.size() );
+  CPPUNIT_ASSERT( encode_range(&v[0], &v[0] + v.size(), &bulk[0], dsc) ==
+                  &bulk[0] + bulk.size() );
+  CPPUNIT_ASSERT( bulk == scalar );
+  ordered_tape t1(test_data, test_data_end);
+  CPPUNIT_ASSERT( std::equal(t1.begin(), t1.end(), vbytes.begin()) );
+
+  // comparing the bytes agrees with comparing the values
+  std::vector<ordered_tape> tapes;
+  std::vector<vbyte_tape> vtapes;
+  zipf z(1 << 20);
+  for (int i = 0; i < 2000; ++i) {
+    std::vector<uint64_t> key;
+    size_t n = size_t(lrand48() % 4);
+    for (size_t j = 0; j < n; ++j) key.push_back(v[lrand48() % v.size()] + z.random() % 3);
+    tapes.push_back(ordered_tape(key.begin(), key.end()));
+    vtapes.push_back(vbyte_tape(key.begin(), key.end()));
+  }
+  for (size_t i = 0; i + 1 < tapes.size(); ++i) {
+    CPPUNIT_ASSERT( (tapes[i] < tapes[i + 1]) == (vtapes[i] < vtapes[i + 1]) );
+    CPPUNIT_ASSERT( (tapes[i] == tapes[i + 1]) == (vtapes[i] == vtapes[i + 1]) );
+  }
+  std::sort(tapes.begin(), tapes.end());
+  std::sort(vtapes.begin(), vtapes.end());
+  for (size_t i = 0; i < tapes.size(); ++i) {
+    CPPUNIT_ASSERT( std::equal(tapes[i].begin(), tapes[i].end(), vtapes[i].begin()) );
+  }
+}
+
+void TapeTest::testZigZag() {
+  typedef tape<zigzag_descriptor> zigzag_tape;
+  zigzag_descriptor dsc;
+  CPPUNIT_ASSERT( dsc.encoded_size(-1) == 1 && dsc.encoded_size(-64) == 1 &&
+                  dsc.encoded_size(63) == 1 && dsc.encoded_size(64) == 2 );
+  CPPUNIT_ASSERT( dsc.encoded_size(std::numeric_limits<int64_t>::min()) == 10 );
+
+  std::vector<int64_t> v;
+  v.push_back(std::numeric_limits<int64_t>::min());
+  v.push_back(std::numeric_limits<int64_t>::max());
+  exponential e(100.0);
+  for (int i = 0; i < 100000; ++i) {
+    int64_t x = int64_t(e.random());
+    v.push_back(i % 2 ? -x : x);
+  }
+  zigzag_tape t(v.begin(), v.end());
+  CPPUNIT_ASSERT( t.size() == v.size() );
+  CPPUNIT_ASSERT( std::equal(t.begin(), t.end(), v.begin()) );
+  CPPUNIT_ASSERT( t.get_extent().byte_size() < 2 * v.size() );
+
+  // backward iteration uses attributes_backward
+  zigzag_tape::const_iterator i = t.end();
+  std::vector<int64_t>::iterator j = v.end();
+  while (i != t.begin()) CPPUNIT_ASSERT( *--i == *--j );
+
+  std::vector<int64_t> decoded(v.size());
+  const uint8_t* first = t.get_extent().storage();
+  const uint8_t* last = t.get_extent().content_end();
+  std::pair<const uint8_t*, int64_t*> r = decode_n(first, last, v.size(), &decoded[0], dsc);
+  CPPUNIT_ASSERT( r.first == last && r.second == &decoded[0] + v.size() );
+  CPPUNIT_ASSERT( decoded == v );
+}
+
+void TapeTest::testDeltaTape() {
+  typedef delta_tape<vbyte_descriptor> vbyte_delta_tape;
+  // the postings of accumulate.cpp
+  uint64_t docids1[] = {123456, 123458, 123461, 124456, 124457, 126123, 126125, 126131};
+  uint64_t docids2[] = {123458, 123459, 123461, 124457, 124459, 126125, 126126, 126131};
+  uint64_t expected[] = {123458, 123461, 124457, 126125, 126131};
+  vbyte_delta_tape d1(docids1, docids1 + 8);
+  vbyte_delta_tape d2;
+  std::list<uint64_t> list2(docids2, docids2 + 8);
+  d2.append(list2.begin(), list2.end());
+  CPPUNIT_ASSERT( d1.size() == 8 && d2.size() == 8 && d2.back() == 126131 );
+  CPPUNIT_ASSERT( *++d1.get_gaps().begin() == 2 );
+  std::vector<uint64_t> intersection;
+  std::set_intersection(d1.begin(), d1.end(), d2.begin(), d2.end(),
+                        std::back_inserter(intersection));
+  CPPUNIT_ASSERT( intersection.size() == 5 &&
+                  std::equal(intersection.begin(), intersection.end(), expected) );
+
+  std::istringstream in("1 5 5 9");
+  std::istream_iterator<uint64_t> in_first(in), in_last;
+  vbyte_delta_tape d3(in_first, in_last);
+  CPPUNIT_ASSERT( d3.size() == 4 && *++d3.begin() == 5 && d3.back() == 9 );
+
+  std::vector<uint64_t> v;
+  uint64_t x(0);
+  zipf z(100000);
+  for (int i = 0; i < 100000; ++i) {
+    x += z.random();
+    v.push_back(x);
+  }
+  vbyte_delta_tape d(v.begin(), v.begin() + 50000);
+  CPPUNIT_ASSERT( d.size() == 50000 );
+  for (size_t i = 50000; i < v.size(); ++i) d.push_back(v[i]);
+  CPPUNIT_ASSERT( d.size() == v.size() && d.back() == v.back() );
+  CPPUNIT_ASSERT( std::equal(d.begin(), d.end(), v.begin()) );
+  CPPUNIT_ASSERT( d == vbyte_delta_tape(v.begin(), v.end()) && d1 < d2 && !(d2 < d1) );
+
+  // iterators do not need to be dereferenced and go backward
+  vbyte_delta_tape::const_iterator i = d.begin();
+  std::advance(i, 777);
+  CPPUNIT_ASSERT( *i == v[777] );
+  i = d.end();
+  std::vector<uint64_t>::iterator j = v.end();
+  while (i != d.begin()) CPPUNIT_ASSERT( *--i == *--j );
+
+  // bulk decoding
+  std::vector<uint64_t> decoded(v.size());
+  CPPUNIT_ASSERT( d.copy_values(&decoded[0]) == &decoded[0] + v.size() );
+  CPPUNIT_ASSERT( decoded == v );
+  std::vector<uint32_t> decoded32(v.size());
+  d.copy_values(&decoded32[0]);
+  CPPUNIT_ASSERT( std::equal(decoded32.begin(), decoded32.end(), v.begin()) );
+
+  // resuming from the last written value
+  const uint8_t* first = d.get_gaps().get_extent().storage();
+  const uint8_t* last = d.get_gaps().get_extent().content_end();
+  std::vector<uint64_t> chunked;
+  uint64_t buffer[1001];
+  uint64_t base(0);
+  while (first != last) {
+    std::pair<const uint8_t*, uint64_t*> p =
+      delta_decode_n(first, last, 1001, buffer, base, vbyte_descriptor());
+    chunked.insert(chunked.end(), buffer, p.second);
+    base = p.second[-1];
+    first = p.first;
+  }
+  CPPUNIT_ASSERT( chunked == v );
+
+  for (size_t n = 0; n < 11; ++n) {
+    uint32_t a[11];
+    uint64_t b[11];
+    std::fill(a, a + n, 3);
+    std::fill(b, b + n, 3);
+    CPPUNIT_ASSERT( prefix_sum(a, a + n, uint32_t(5)) == 5 + 3 * n );
+    CPPUNIT_ASSERT( prefix_sum(b, b + n, uint64_t(5)) == 5 + 3 * n );
+    for (size_t k = 0; k < n; ++k) CPPUNIT_ASSERT( a[k] == 8 + 3 * k && b[k] == 8 + 3 * k );
+  }
+}
+
+void TapeTest::testGorilla() {
+  typedef tape<gorilla_descriptor> gorilla_tape;
+  // a gauge: a reading with two decimals that changes every few samples
+  std::vector<double> v;
+  double reading(20.0);
+  for (int i = 0; i < 100000; ++i) {
+    if (lrand48() % 8 == 0) reading += double(lrand48() % 21 - 10) / 100.0;
+    v.push_back(reading);
+  }
+  // values whose bits matter
+  v.push_back(0.0);
+  v.push_back(-0.0);
+  v.push_back(std::numeric_limits<double>::quiet_NaN());
+  v.push_back(std::numeric_limits<double>::infinity());
+  v.push_back(std::numeric_limits<double>::denorm_min());
+  v.push_back(-std::numeric_limits<double>::max());
+  for (int i = 0; i < 1000; ++i) v.push_back(drand48());
+
+  gorilla_tape blocks;
+  append_blocks(blocks, v.begin(), v.end());
+  CPPUNIT_ASSERT( blocks.get_extent().byte_size() * 4 < v.size() * sizeof(double) );
+
+  std::vector<double> decoded(v.size());
+  const uint8_t* first = blocks.get_extent().storage();
+  const uint8_t* last = blocks.get_extent().content_end();
+  std::pair<const uint8_t*, double*> r = decode_n(first, last, v.size(), &decoded[0],
+                                                  gorilla_descriptor());
+  CPPUNIT_ASSERT( r.first == last && r.second == &decoded[0] + v.size() );
+  CPPUNIT_ASSERT( memcmp(&decoded[0], &v[0], v.size() * sizeof(double)) == 0 );
+
+  std::vector<double> iterated(element_iterator(blocks.begin()), element_iterator(blocks.end()));
+  CPPUNIT_ASSERT( memcmp(&iterated[0], &v[0], v.size() * sizeof(double)) == 0 );
+
+  // a constant series takes about a bit per value
+  std::vector<double> constant(1280, 3.25);
+  gorilla_tape constant_blocks;
+  append_blocks(constant_blocks, constant.begin(), constant.end());
+  CPPUNIT_ASSERT( constant_blocks.get_extent().byte_size() == 10 * (3 + 8 + 16) );
+}
+
+void TapeTest::testStrings() {
+  typedef tape<string_descriptor> string_tape;
+  typedef tape<ordered_string_descriptor> ordered_string_tape;
+  std::set<std::string> vocabulary;
+  vocabulary.insert("");
+  vocabulary.insert(std::string(1, '\0'));
+  vocabulary.insert(std::string("a\0", 2));
+  vocabulary.insert(std::string("a\0\1", 3));
+  vocabulary.insert(std::string("a\1", 2));
+  vocabulary.insert(std::string(300, 'x'));
+  vocabulary.insert("\xff\xfe");
+  for (int i = 0; i < 1000; ++i) {
+    std::string word;
+    size_t n = size_t(lrand48() % 8);
+    for (size_t j = 0; j < n; ++j) word.push_back(char("ab\0\1\xff"[lrand48() % 5]));
+    vocabulary.insert(word);
+  }
+
+  string_tape words(vocabulary.begin(), vocabulary.end());
+  CPPUNIT_ASSERT( words.size() == vocabulary.size() );
+  CPPUNIT_ASSERT( std::equal(words.begin(), words.end(), vocabulary.begin()) );
+  string_ref x = *++words.begin();
+  CPPUNIT_ASSERT( x.size() == 1 && x[0] == '\0' && x.str() == *++vocabulary.begin() );
+  words.push_back("last");
+  std::ostringstream out;
+  std::copy(words.begin(), words.end(), std::ostream_iterator<string_ref>(out));
+  CPPUNIT_ASSERT( out.str().size() > 300 && out.str().substr(out.str().size() - 4) == "last" );
+
+  // a string of the tape pushed back into it, through reallocations, and
+  // into a gap buffer in front of it
+  std::string long_word(300, 'x');
+  string_tape echo;
+  echo.push_back(long_word);
+  for (int k = 0; k < 6; ++k) echo.push_back(*echo.begin());
+  CPPUNIT_ASSERT( echo.size() == 7 );
+  for (string_tape::const_iterator k = echo.begin(); k != echo.end(); ++k) {
+    CPPUNIT_ASSERT( *k == long_word );
+  }
+  gap_buffer_tape<string_descriptor> gap(words.begin(), words.end());
+  gap_buffer_tape<string_descriptor>::const_iterator last_word = gap.begin();
+  std::advance(last_word, words.size() - 1);
+  gap.insert(gap.begin(), *last_word);
+  CPPUNIT_ASSERT( gap.size() == words.size() + 1 );
+  CPPUNIT_ASSERT( *gap.begin() == "last" );
+  CPPUNIT_ASSERT( std::equal(words.begin(), words.end(), ++gap.begin()) );
+
+  ordered_string_tape ordered(vocabulary.begin(), vocabulary.end());
+  CPPUNIT_ASSERT( std::equal(ordered.begin(), ordered.end(), vocabulary.begin()) );
+  ordered_string_tape::const_iterator i = ordered.end();
+  std::set<std::string>::iterator j = vocabulary.end();
+  while (i != ordered.begin()) CPPUNIT_ASSERT( *--i == *--j );
+
+  // comparing the bytes agrees with comparing the strings
+  std::vector<std::vector<std::string> > keys;
+  std::vector<std::string> v(vocabulary.begin(), vocabulary.end());
+  for (int k = 0; k < 500; ++k) {
+    std::vector<std::string> key;
+    size_t n = size_t(lrand48() % 3);
+    for (size_t m = 0; m < n; ++m) key.push_back(v[lrand48() % 6]);
+    keys.push_back(key);
+  }
+  for (size_t k = 0; k + 1 < keys.size(); ++k) {
+    ordered_string_tape a(keys[k].begin(), keys[k].end());
+    ordered_string_tape b(keys[k + 1].begin(), keys[k + 1].end());
+    string_tape c(keys[k].begin(), keys[k].end());
+    string_tape d(keys[k + 1].begin(), keys[k + 1].end());
+    CPPUNIT_ASSERT( (a < b) == (keys[k] < keys[k + 1]) );
+    CPPUNIT_ASSERT( (c < d) == (keys[k] < keys[k + 1]) );
+    CPPUNIT_ASSERT( (a == b) == (keys[k] == keys[k + 1]) && (c == d) == (a == b) );
+  }
+}
+
+inline
+bool is_random_access(std::random_access_iterator_tag) { return true; }
+
+inline
+bool is_random_access(std::input_iterator_tag) { return false; }
+
+void TapeTest::testFixedWidth() {
+  typedef tape<fixed_width_descriptor<3> > column;
+  typedef column::const_iterator iterator;
+  CPPUNIT_ASSERT( is_random_access(std::iterator_traits<iterator>::iterator_category()) );
+  CPPUNIT_ASSERT( !is_random_access(std::iterator_traits<vbyte_tape::const_iterator>::iterator_category()) );
+  CPPUNIT_ASSERT( fixed_width_descriptor<3>::max_value() == 0xffffff );
+  CPPUNIT_ASSERT( fixed_width_descriptor<8>::max_value() == std::numeric_limits<uint64_t>::max() );
+
+  std::vector<uint64_t> v;
+  for (int i = 0; i < 100000; ++i) v.push_back(uint64_t(lrand48()) & 0xffffff);
+  v.push_back(0xffffff);
+  std::sort(v.begin(), v.end());
+  column c(v.begin(), v.end());
+  CPPUNIT_ASSERT( c.get_extent().byte_size() == 3 * v.size() );
+  CPPUNIT_ASSERT( std::equal(c.begin(), c.end(), v.begin()) );
+  CPPUNIT_ASSERT( c.end() - c.begin() == ptrdiff_t(v.size()) );
+  CPPUNIT_ASSERT( c.begin()[777] == v[777] && *(c.end() - 1) == 0xffffff );
+  iterator i = c.begin();
+  i += 1000;
+  i -= 10;
+  CPPUNIT_ASSERT( *i == v[990] && c.begin() < i && i - c.begin() == 990 );
+
+  for (int k = 0; k < 1000; ++k) {
+    uint64_t x = uint64_t(lrand48()) & 0xffffff;
+    CPPUNIT_ASSERT( std::lower_bound(c.begin(), c.end(), x) - c.begin() ==
+                    std::lower_bound(v.begin(), v.end(), x) - v.begin() );
+  }
+
+  // erase and insert keep the iterators random access
+  c.erase(c.begin() + 10, c.begin() + 20);
+  v.erase(v.begin() + 10, v.begin() + 20);
+  CPPUNIT_ASSERT( c.size() == v.size() && std::equal(c.begin(), c.end(), v.begin()) );
+
+  // big-endian bytes preserve order
+  uint64_t a[] = { 1, 256 };
+  uint64_t b[] = { 2 };
+  CPPUNIT_ASSERT( column(a, a + 2) < column(b, b + 1) && column(a, a + 1) < column(a, a + 2) );
+}
+
+void TapeTest::testAdaptive() {
+  typedef tape<adaptive_descriptor> adaptive_tape;
+  adaptive_descriptor dsc;
+  std::vector<uint64_t> v;
+  exponential e(4.0);
+  for (int i = 0; i < 128 * 100; ++i) v.push_back(uint64_t(e.random()));  // dense runs
+  for (int i = 0; i < 128 * 10; ++i) {                                   // 64-bit words
+    v.push_back(uint64_t(lrand48()) << 32 | uint64_t(lrand48()));
+  }
+  for (int i = 0; i < 128 * 10; ++i) {                                   // rare outliers
+    v.push_back(i % 100 == 0 ? uint64_t(1) << 40 : uint64_t(i % 7));
+  }
+  for (int i = 0; i < 128 + 5; ++i) v.push_back(0);
+  v.push_back(std::numeric_limits<uint64_t>::max());
+
+  adaptive_tape blocks;
+  append_blocks(blocks, v.begin(), v.end());
+  CPPUNIT_ASSERT( std::equal(v.begin(), v.end(), element_iterator(blocks.begin())) );
+  vbyte_tape vbytes1(v.begin(), v.end());
+  CPPUNIT_ASSERT( blocks.get_extent().byte_size() < vbytes1.get_extent().byte_size() );
+
+  // every kind of block chooses its own mode
+  adaptive_tape::const_iterator i = blocks.begin();
+  const uint8_t* p = i.state().position;
+  CPPUNIT_ASSERT( (p[1] & adaptive_descriptor::mode_mask) == adaptive_descriptor::bit_packing_mode );
+  std::advance(i, 100);
+  p = i.state().position;
+  CPPUNIT_ASSERT( p[1] == (adaptive_descriptor::raw_mode | 8) );
+  std::advance(i, 10);
+  p = i.state().position;
+  CPPUNIT_ASSERT( (p[1] & adaptive_descriptor::mode_mask) == adaptive_descriptor::vbyte_mode );
+  std::advance(i, 10);
+  p = i.state().position;
+  CPPUNIT_ASSERT( p[1] == adaptive_descriptor::bit_packing_mode && dsc.size(p) == 2 );
+
+  std::vector<uint64_t> decoded(v.size());
+  const uint8_t* first = blocks.get_extent().storage();
+  const uint8_t* last = blocks.get_extent().content_end();
+  std::pair<const uint8_t*, uint64_t*> r = decode_n(first, last, v.size(), &decoded[0], dsc);
+  CPPUNIT_ASSERT( r.first == last && r.second == &decoded[0] + v.size() );
+  CPPUNIT_ASSERT( decoded == v );
+
+  // widths that vary within 32 bits, where stream VByte uses a byte less
+  // than vbyte for each of 200, 60000 and 16000000
+  uint64_t widths[] = { 1, 200, 60000, 16000000 };
+  std::vector<uint64_t> gaps;
+  for (int k = 0; k < 1000; ++k) gaps.push_back(widths[k % 4]);
+  adaptive_tape zipf_blocks;
+  append_blocks(zipf_blocks, gaps.begin(), gaps.end());
+  p = zipf_blocks.begin().state().position;
+  CPPUNIT_ASSERT( p[1] == adaptive_descriptor::stream_vbyte_mode );
+  CPPUNIT_ASSERT( std::equal(gaps.begin(), gaps.end(), element_iterator(zipf_blocks.begin())) );
+
+  // raw blocks of every width
+  for (unsigned w = 1; w <= 8; ++w) {
+    std::vector<uint64_t> words;
+    for (int k = 0; k < 100; ++k) {
+      uint64_t x = uint64_t(lrand48()) << 32 | uint64_t(lrand48());
+      words.push_back((x >> (64 - 8 * w)) | (uint64_t(1) << (8 * w - 1)));
+    }
+    adaptive_tape t;
+    append_blocks(t, words.begin(), words.end());
+    CPPUNIT_ASSERT( std::equal(words.begin(), words.end(), element_iterator(t.begin())) );
+  }
+}
+
+void TapeTest::testTranscode() {
+  std::vector<uint64_t> v;
+  zipf z(1 << 30);
+  for (int i = 0; i < 100000; ++i) v.push_back(z.random());
+  v.push_back(std::numeric_limits<uint64_t>::max());
+  vbyte_tape source(v.begin(), v.end());
+
+  tape<ordered_integer_descriptor> ordered = transcode<ordered_integer_descriptor>(source);
+  CPPUNIT_ASSERT( ordered.size() == v.size() );
+  CPPUNIT_ASSERT( std::equal(ordered.begin(), ordered.end(), v.begin()) );
+  CPPUNIT_ASSERT( ordered.get_extent().remaining_byte_capacity() == 0 );
+
+  tape<fixed_width_descriptor<8> > fixed = transcode(ordered, fixed_width_descriptor<8>());
+  CPPUNIT_ASSERT( fixed.get_extent().byte_size() == 8 * v.size() );
+  CPPUNIT_ASSERT( std::equal(fixed.begin(), fixed.end(), v.begin()) );
+
+  vbyte_tape back = transcode<vbyte_descriptor>(fixed);
+  CPPUNIT_ASSERT( back == source );
+
+  // to a descriptor with another value type
+  tape<zigzag_descriptor> signed_values = transcode<zigzag_descriptor>(vbytes);
+  CPPUNIT_ASSERT( std::equal(signed_values.begin(), signed_values.end(), test_data) );
+
+  vbyte_tape empty;
+  CPPUNIT_ASSERT( transcode<ordered_integer_descriptor>(empty).empty() );
+
+  // between tapes with other policies, replacing the values of the result
+  tape<vbyte_descriptor, malloc_allocator, exact_growth, small_extent> small(v.begin(), v.end());
+  tape<ordered_integer_descriptor, malloc_allocator, one_and_a_half_growth, shared_extent> shared;
+  shared.push_back(1);
+  transcode(small, shared);
+  CPPUNIT_ASSERT( shared.size() == v.size() );
+  CPPUNIT_ASSERT( std::equal(shared.begin(), shared.end(), v.begin()) );
+  CPPUNIT_ASSERT( shared.get_extent().remaining_byte_capacity() == 0 );
+  CPPUNIT_ASSERT( transcode<vbyte_descriptor>(small) == source );
+  // values growing past the estimate from the first buffer
+  std::vector<uint64_t> growing(1024, 1);
+  growing.resize(3000, std::numeric_limits<uint64_t>::max());
+  vbyte_tape growing_source(growing.begin(), growing.end());
+  vbyte_tape copied;
+  transcode(growing_source, copied);
+  CPPUNIT_ASSERT( copied == growing_source );
+  CPPUNIT_ASSERT( copied.get_extent().remaining_byte_capacity() == 0 );
+
+  std::vector<std::string> words;
+  words.push_back("transcode");
+  words.push_back(std::string("a\0b", 3));
+  words.push_back("");
+  tape<ordered_string_descriptor> ordered_strings(words.begin(), words.end());
+  tape<string_descriptor> strings = transcode<string_descriptor>(ordered_strings);
+  CPPUNIT_ASSERT( std::equal(strings.begin(), strings.end(), words.begin()) );
+}
+
+
+void TapeTest::testTapeOfTapes() {
+  typedef tape_of_tapes<vbyte_descriptor> postings_type;
+  postings_type postings;
+  CPPUNIT_ASSERT( postings.empty() );
+  CPPUNIT_ASSERT( postings.begin() == postings.end() );
+
+  // a posting list: for every document, the positions of a term
+  std::vector<std::vector<uint64_t> > positions(1000);
+  zipf z(1 << 20);
+  for (size_t i = 0; i < positions.size(); ++i) {
+    for (size_t j = 0; j < i % 17; ++j) positions[i].push_back(z.random());
+    postings.push_back(positions[i].begin(), positions[i].end());
+  }
+  CPPUNIT_ASSERT( postings.size() == positions.size() );
+
+  size_t i = 0;
+  for (postings_type::const_iterator t = postings.begin(); t != postings.end(); ++t, ++i) {
+    tape_view<vbyte_descriptor> document = *t;
+    CPPUNIT_ASSERT( document.size() == positions[i].size() );
+    CPPUNIT_ASSERT( document.empty() == positions[i].empty() );
+    CPPUNIT_ASSERT( std::equal(document.begin(), document.end(), positions[i].begin()) );
+    CPPUNIT_ASSERT( document.to_tape() == vbyte_tape(positions[i].begin(), positions[i].end()) );
+  }
+  CPPUNIT_ASSERT( i == positions.size() );
+
+  // the sub-tapes of a bidirectional descriptor go backward
+  tape_view<vbyte_descriptor> document = *++postings.begin();
+  CPPUNIT_ASSERT( *--document.end() == positions[1].back() );
+
+  // tapes are copied in, views compare by value
+  postings_type copies;
+  copies.push_back(vbytes);
+  copies.push_back(vbyte_tape());
+  copies.push_back(*++postings.begin());
+  CPPUNIT_ASSERT( copies.size() == 3 );
+  CPPUNIT_ASSERT( *copies.begin() == tape_view<vbyte_descriptor>(vbytes) );
+  CPPUNIT_ASSERT( std::equal((*copies.begin()).begin(), (*copies.begin()).end(), test_data) );
+  CPPUNIT_ASSERT( (*++copies.begin()).empty() );
+  CPPUNIT_ASSERT( *++copies.begin() < *copies.begin() );
+
+  // a sub-tape pushed back into its own tape of tapes, through reallocations
+  postings_type echo;
+  echo.push_back(vbytes);
+  for (int k = 0; k < 6; ++k) echo.push_back(*echo.begin());
+  CPPUNIT_ASSERT( echo.size() == 7 );
+  for (postings_type::const_iterator k = echo.begin(); k != echo.end(); ++k) {
+    CPPUNIT_ASSERT( *k == tape_view<vbyte_descriptor>(vbytes) );
+  }
+
+  std::vector<vbyte_tape> tapes;
+  tapes.push_back(vbytes);
+  tapes.push_back(vbyte_tape());
+  tapes.push_back(vbyte_tape(positions[1].begin(), positions[1].end()));
+  postings_type from_range(tapes.begin(), tapes.end());
+  postings_type from_views(copies.begin(), copies.end());
+  CPPUNIT_ASSERT( from_range.size() == 3 );
+  CPPUNIT_ASSERT( from_range == from_views );
+  CPPUNIT_ASSERT( from_range != postings );
+
+  // one extent for all the sub-tapes
+  CPPUNIT_ASSERT( from_range.byte_size() ==
+                  2 + vbytes.get_extent().byte_size() +
+                  2 +
+                  2 + vbyte_descriptor().encoded_size(positions[1][0]) );
+}
+
+void TapeTest::testCpuDispatch() {
+  vbyte_descriptor dsc;
+  for (size_t b = 0; b < 64; ++b) {
+    uint64_t x = uint64_t(1) << b;
+    CPPUNIT_ASSERT( dsc.encoded_size(x) == b / 7 + 1 );
+    CPPUNIT_ASSERT( dsc.encoded_size(x - 1) == (b ? (b - 1) / 7 + 1 : 1) );
+  }
+  CPPUNIT_ASSERT( dsc.encoded_size(std::numeric_limits<uint64_t>::max()) == 10 );
+
+  std::vector<uint64_t> v;
+  zipf z(std::numeric_limits<uint64_t>::max());
+  for (size_t i = 0; i < 10003; ++i) v.push_back(i % 5 ? z.random() : uint64_t(i) << (i % 64));
+  std::vector<uint32_t> w(v.begin(), v.end());
+  vbyte_tape expected;
+  for (size_t i = 0; i < v.size(); ++i) expected.push_back(v[i]);
+  tape<stream_vbyte_descriptor> blocks;
+  append_blocks(blocks, w.begin(), w.end());
+  tape<group_varint_descriptor> groups;
+  append_blocks(groups, w.begin(), w.end());
+
+  const cpu_level detected = current_cpu_level();
+  for (int level = scalar_cpu; level <= avx512_cpu; ++level) {
+    CPPUNIT_ASSERT( set_cpu_level(cpu_level(level)) == std::min(cpu_level(level), detected) );
+
+    const uint64_t* first = &v[0];
+    CPPUNIT_ASSERT( total_encoded_size(first, first + v.size(), dsc) ==
+                    std::make_pair(expected.get_extent().byte_size(), v.size()) );
+    vbyte_tape t(first, first + v.size());
+    CPPUNIT_ASSERT( t == expected );
+
+    std::vector<uint64_t> decoded(v.size());
+    const uint8_t* p = t.get_extent().storage();
+    decode_n(p, t.get_extent().content_end(), v.size(), &decoded[0], dsc);
+    CPPUNIT_ASSERT( decoded == v );
+
+    std::vector<uint32_t> decoded32(w.size());
+    p = blocks.get_extent().storage();
+    decode_n(p, blocks.get_extent().content_end(), w.size(), &decoded32[0], stream_vbyte_descriptor());
+    CPPUNIT_ASSERT( decoded32 == w );
+    std::fill(decoded32.begin(), decoded32.end(), 0);
+    p = groups.get_extent().storage();
+    decode_n(p, groups.get_extent().content_end(), w.size(), &decoded32[0], group_varint_descriptor());
+    CPPUNIT_ASSERT( decoded32 == w );
+  }
+  set_cpu_level(detected);
+  CPPUNIT_ASSERT( current_cpu_level() == detect_cpu_level() );
+}
+
+void TapeTest::testHybridSet() {
+  // a sparse chunk, a dense chunk, a chunk of runs and a chunk holding 65535
+  std::vector<uint64_t> v;
+  for (uint64_t x = 5; x < 65536; x += 1000) v.push_back(x);
+  for (uint64_t x = 65536; x < 2 * 65536; ++x) if (x % 3) v.push_back(x);
+  for (uint64_t x = 3 * 65536; x < 4 * 65536; x += 1000) {
+    for (uint64_t k = 0; k < 500; ++k) v.push_back(x + k);
+  }
+  v.push_back(7 * 65536 + 65535);
+  vbyte_tape t(v.begin(), v.end());
+
+  hybrid_set s(t.begin(), t.end());
+  CPPUNIT_ASSERT( s.size() == v.size() );
+  const std::vector<hybrid_set::chunk>& chunks = s.get_chunks();
+  CPPUNIT_ASSERT( chunks.size() == 4 );
+  CPPUNIT_ASSERT( chunks[0].kind == hybrid_set::array_chunk );
+  CPPUNIT_ASSERT( chunks[1].kind == hybrid_set::bitmap_chunk );
+  CPPUNIT_ASSERT( chunks[2].kind == hybrid_set::run_chunk );
+  CPPUNIT_ASSERT( chunks[3].kind == hybrid_set::array_chunk && chunks[3].key == 7 );
+  CPPUNIT_ASSERT( std::equal(s.begin(), s.end(), v.begin()) );
+  CPPUNIT_ASSERT( s.to_tape() == t );
+  CPPUNIT_ASSERT( s.byte_size() < t.get_extent().byte_size() / 2 );
+  for (uint32_t x = 0; x < 8 * 65536; x += 7) {
+    CPPUNIT_ASSERT( s.contains(x) == std::binary_search(v.begin(), v.end(), uint64_t(x)) );
+  }
+
+  // duplicates are ignored
+  std::vector<uint64_t> w;
+  for (size_t i = 0; i < v.size(); i += 3) {
+    w.push_back(v[i] + 1);
+    w.push_back(v[i] + 1);
+  }
+  w.push_back(5 * 65536);
+  vbyte_tape u(w.begin(), w.end());
+  w.erase(std::unique(w.begin(), w.end()), w.end());
+  hybrid_set r(w.begin(), w.end());
+  CPPUNIT_ASSERT( r.size() == w.size() && std::equal(r.begin(), r.end(), w.begin()) );
+
+  std::vector<uint64_t> expected;
+  std::set_intersection(v.begin(), v.end(), w.begin(), w.end(), std::back_inserter(expected));
+  hybrid_set i = set_intersection(s, r);
+  CPPUNIT_ASSERT( i.size() == expected.size() && std::equal(i.begin(), i.end(), expected.begin()) );
+  CPPUNIT_ASSERT( set_intersection(s, u) == i && set_intersection(u, s) == i );
+  CPPUNIT_ASSERT( set_intersection(s, hybrid_set()).empty() );
+
+  expected.clear();
+  std::set_union(v.begin(), v.end(), w.begin(), w.end(), std::back_inserter(expected));
+  hybrid_set j = set_union(s, r);
+  CPPUNIT_ASSERT( j.size() == expected.size() && std::equal(j.begin(), j.end(), expected.begin()) );
+  CPPUNIT_ASSERT( set_union(s, u) == j && set_union(u, s) == j );
+  CPPUNIT_ASSERT( set_union(s, hybrid_set()) == s );
+
+  hybrid_set empty;
+  CPPUNIT_ASSERT( empty.begin() == empty.end() && empty.to_tape().empty() );
+}
+
+struct test_arena_tag {};
+
+void TapeTest::testAllocationPolicy() {
+  std::vector<uint64_t> v;
+  zipf z(1 << 20);
+  for (int i = 0; i < 1000; ++i) v.push_back(z.random());
+  vbyte_tape expected(v.begin(), v.end());
+
+  typedef tape<vbyte_descriptor, pool_allocator<> > pool_tape;
+  {
+    std::vector<pool_tape> tapes(100);
+    for (size_t i = 0; i < tapes.size(); ++i) {
+      // a few values each, and one tape larger than the largest size class
+      size_t n = i == 0 ? v.size() : i % 8;
+      for (size_t j = 0; j < n; ++j) tapes[i].push_back(v[j]);
+    }
+    for (size_t i = 0; i < tapes.size(); ++i) {
+      size_t n = i == 0 ? v.size() : i % 8;
+      CPPUNIT_ASSERT( tapes[i].size() == n );
+      CPPUNIT_ASSERT( std::equal(tapes[i].begin(), tapes[i].end(), v.begin()) );
+    }
+    pool_tape copy(tapes[0]);
+    CPPUNIT_ASSERT( copy == tapes[0] );
+    copy.erase(copy.begin(), copy.end());
+    CPPUNIT_ASSERT( copy.empty() );
+  }
+
+  typedef tape<vbyte_descriptor, arena_allocator<test_arena_tag> > arena_tape;
+  arena a(4096);
+  {
+    arena_scope<test_arena_tag> scope(a);
+    std::vector<arena_tape> tapes;
+    for (size_t i = 0; i < 100; ++i) tapes.push_back(arena_tape(v.begin(), v.begin() + i));
+    arena_tape large(v.begin(), v.end());
+    CPPUNIT_ASSERT( std::equal(large.begin(), large.end(), expected.begin()) );
+    for (size_t i = 0; i < tapes.size(); ++i) {
+      CPPUNIT_ASSERT( tapes[i].size() == i );
+      CPPUNIT_ASSERT( std::equal(tapes[i].begin(), tapes[i].end(), v.begin()) );
+    }
+    CPPUNIT_ASSERT( a.byte_size() >= large.get_extent().total_byte_size() );
+  }
+  CPPUNIT_ASSERT( a.byte_size() > 0 );
+  a.release();
+  CPPUNIT_ASSERT( a.byte_size() == 0 );
+
+  // without a current arena
+  bool thrown = false;
+  try {
+    arena_tape t(v.begin(), v.end());
+  } catch (std::bad_alloc&) {
+    thrown = true;
+  }
+  CPPUNIT_ASSERT( thrown );
+}
+
+// malloc without resizing, to test the path that moves the contents
+struct copying_allocator {
+  static void* allocate(size_t n) { return malloc_allocator::allocate(n); }
+  static void deallocate(void* p, size_t n) { malloc_allocator::deallocate(p, n); }
+  static void* reallocate(void*, size_t, size_t) { return NULL; }
+};
+
+template <typename Tape>
+void check_growth(const std::vector<uint64_t>& v) {
+  Tape t;
+  std::vector<uint64_t> expected;
+  for (size_t i = 0; i < v.size(); ++i) {
+    // alternately at the end and at the beginning
+    if (i % 2) {
+      t.push_back(v[i]);
+      expected.push_back(v[i]);
+    } else {
+      t.insert(t.begin(), &v[i], &v[i] + 1);
+      expected.insert(expected.begin(), v[i]);
+    }
+  }
+  CPPUNIT_ASSERT( t.size() == expected.size() );
+  CPPUNIT_ASSERT( std::equal(t.begin(), t.end(), expected.begin()) );
+  t.adjust_byte_capacity(0);
+  CPPUNIT_ASSERT( t.get_extent().remaining_byte_capacity() == 0 );
+  CPPUNIT_ASSERT( std::equal(t.begin(), t.end(), expected.begin()) );
+  t.adjust_byte_capacity(100);
+  CPPUNIT_ASSERT( t.get_extent().remaining_byte_capacity() == 100 );
+  CPPUNIT_ASSERT( std::equal(t.begin(), t.end(), expected.begin()) );
+}
+
+void TapeTest::testGrowthPolicy() {
+  std::vector<uint64_t> v;
+  zipf z(1 << 30);
+  for (int i = 0; i < 3000; ++i) v.push_back(z.random());
+
+  check_growth<tape<vbyte_descriptor> >(v);
+  check_growth<tape<vbyte_descriptor, copying_allocator> >(v);
+  check_growth<tape<vbyte_descriptor, malloc_allocator, one_and_a_half_growth> >(v);
+  check_growth<tape<vbyte_descriptor, copying_allocator, one_and_a_half_growth> >(v);
+  check_growth<tape<vbyte_descriptor, malloc_allocator, exact_growth> >(v);
+  check_growth<tape<vbyte_descriptor, pool_allocator<>, exact_growth> >(v);
+
+  tape<vbyte_descriptor, malloc_allocator, exact_growth> exact;
+  for (size_t i = 0; i < 100; ++i) {
+    exact.push_back(v[i]);
+    CPPUNIT_ASSERT( exact.get_extent().remaining_byte_capacity() == 0 );
+  }
+
+  tape<vbyte_descriptor, copying_allocator, one_and_a_half_growth> one_and_a_half;
+  one_and_a_half.push_back(uint64_t(1) << 62); // 9 bytes
+  one_and_a_half.adjust_byte_capacity(0);
+  for (size_t i = 0; i < 10; ++i) one_and_a_half.push_back(0);
+  CPPUNIT_ASSERT( one_and_a_half.get_extent().byte_capacity() == 9 + 4 + 6 );
+
+  // the last allocation of an arena grows in place
+  typedef tape<vbyte_descriptor, arena_allocator<test_arena_tag> > arena_tape;
+  arena a(1 << 16);
+  {
+    arena_scope<test_arena_tag> scope(a);
+    arena_tape t;
+    for (size_t i = 0; i < v.size(); ++i) t.push_back(v[i]);
+    CPPUNIT_ASSERT( std::equal(t.begin(), t.end(), v.begin()) );
+    CPPUNIT_ASSERT( a.byte_size() <= size_t(1 << 16) + 64 );
+    check_growth<arena_tape>(v);
+  }
+}
+
+void TapeTest::testSmallExtent() {
+  typedef tape<vbyte_descriptor, malloc_allocator, doubling_growth, small_extent> small_tape;
+  CPPUNIT_ASSERT( sizeof(small_tape) == sizeof(vbyte_tape) );
+
+  std::vector<uint64_t> v;
+  zipf z(1 << 20);
+  for (int i = 0; i < 100; ++i) v.push_back(z.random());
+
+  small_tape t;
+  vbyte_tape expected;
+  CPPUNIT_ASSERT( t.empty() );
+  CPPUNIT_ASSERT( t.get_extent().is_inline() );
+  for (size_t i = 0; i < v.size(); ++i) {
+    t.push_back(v[i]);
+    expected.push_back(v[i]);
+    CPPUNIT_ASSERT( t.size() == i + 1 );
+    CPPUNIT_ASSERT( t.get_extent().is_inline() ==
+                    (expected.get_extent().byte_size() <= small_tape::extent_type::inline_capacity) );
+  }
+  CPPUNIT_ASSERT( std::equal(t.begin(), t.end(), expected.begin()) );
+  CPPUNIT_ASSERT( t.get_extent().byte_size() == expected.get_extent().byte_size() );
+
+  // back to inline after erasing
+  small_tape::const_iterator first = t.begin();
+  std::advance(first, 3);
+  t.erase(first, t.end());
+  CPPUNIT_ASSERT( t.size() == 3 );
+  CPPUNIT_ASSERT( !t.get_extent().is_inline() );
+  small_tape copy(t);
+  CPPUNIT_ASSERT( copy.get_extent().is_inline() );
+  CPPUNIT_ASSERT( copy == t );
+  t.adjust_byte_capacity(0);
+  CPPUNIT_ASSERT( t.get_extent().is_inline() );
+  CPPUNIT_ASSERT( t.size() == 3 );
+  CPPUNIT_ASSERT( std::equal(t.begin(), t.end(), v.begin()) );
+
+  // reserving moves the bytes to a block, which keeps the count
+  t.adjust_byte_capacity(100);
+  CPPUNIT_ASSERT( !t.get_extent().is_inline() );
+  CPPUNIT_ASSERT( t.get_extent().remaining_byte_capacity() == 100 );
+  CPPUNIT_ASSERT( t.size() == 3 );
+  t.push_back(v[3]);
+  CPPUNIT_ASSERT( t.size() == 4 );
+  CPPUNIT_ASSERT( std::equal(t.begin(), t.end(), v.begin()) );
+
+  // inserting in the middle, inline and spilling
+  small_tape u(v.begin(), v.begin() + 2);
+  first = u.begin();
+  ++first;
+  u.insert(first, v.begin() + 2, v.begin() + 3);
+  std::vector<uint64_t> w(v.begin(), v.begin() + 3);
+  std::swap(w[1], w[2]);
+  CPPUNIT_ASSERT( std::equal(u.begin(), u.end(), w.begin()) );
+  first = u.begin();
+  ++first;
+  u.insert(first, v.begin() + 3, v.end());
+  w.insert(w.begin() + 1, v.begin() + 3, v.end());
+  CPPUNIT_ASSERT( !u.get_extent().is_inline() );
+  CPPUNIT_ASSERT( u.size() == w.size() );
+  CPPUNIT_ASSERT( std::equal(u.begin(), u.end(), w.begin()) );
+
+  swap(t, u);
+  CPPUNIT_ASSERT( std::equal(t.begin(), t.end(), w.begin()) );
+  CPPUNIT_ASSERT( std::equal(u.begin(), u.end(), v.begin()) );
+  u = t;
+  CPPUNIT_ASSERT( u == t );
+  u.erase(u.begin(), u.end());
+  CPPUNIT_ASSERT( u.empty() );
+  CPPUNIT_ASSERT( u.get_extent().is_inline() );
+
+  // a descriptor without a prefixed size
+  typedef tape<string_descriptor, malloc_allocator, doubling_growth, small_extent> small_string_tape;
+  small_string_tape s;
+  s.push_back("tiny");
+  s.push_back("tape");
+  CPPUNIT_ASSERT( s.get_extent().is_inline() );
+  CPPUNIT_ASSERT( s.size() == 2 );
+  CPPUNIT_ASSERT( *s.begin() == "tiny" );
+  s.push_back("and then some");
+  CPPUNIT_ASSERT( !s.get_extent().is_inline() );
+  CPPUNIT_ASSERT( s.size() == 3 );
+
+  std::vector<small_tape> tapes(10, small_tape(v.begin(), v.begin() + 2));
+  tapes.resize(1000, tapes[0]);
+  CPPUNIT_ASSERT( std::equal(tapes[999].begin(), tapes[999].end(), v.begin()) );
+}
+
+// a descriptor with state, to check that it follows the bytes
+struct labeled_vbyte_descriptor : vbyte_descriptor {
+  int label;
+  labeled_vbyte_descriptor(int label = 0) : label(label) {}
+};
+
+void TapeTest::testMoveSemantics() {
+  const size_t test_size = test_data_end - test_data;
+  typedef tape<labeled_vbyte_descriptor> labeled_tape;
+  labeled_tape x(test_data, test_data + test_size, labeled_vbyte_descriptor(1));
+  labeled_tape y(test_data, test_data + 2, labeled_vbyte_descriptor(2));
+  swap(x, y);
+  CPPUNIT_ASSERT( x.descriptor().label == 2 && x.size() == 2 );
+  CPPUNIT_ASSERT( y.descriptor().label == 1 && y.size() == test_size );
+
+#if __cplusplus >= 201103L
+  typedef tape<vbyte_descriptor, malloc_allocator, doubling_growth, small_extent> small_tape;
+  CPPUNIT_ASSERT( std::is_nothrow_move_constructible<vbyte_tape>::value );
+  CPPUNIT_ASSERT( std::is_nothrow_move_assignable<vbyte_tape>::value );
+  CPPUNIT_ASSERT( std::is_nothrow_move_constructible<small_tape>::value );
+  CPPUNIT_ASSERT( std::is_nothrow_move_assignable<small_tape>::value );
+
+  // moving takes over the extent
+  const uint8_t* bytes = y.get_extent().storage();
+  labeled_tape z(std::move(y));
+  CPPUNIT_ASSERT( y.empty() );
+  CPPUNIT_ASSERT( z.get_extent().storage() == bytes );
+  CPPUNIT_ASSERT( z.descriptor().label == 1 );
+  CPPUNIT_ASSERT( std::equal(z.begin(), z.end(), test_data) );
+  x = std::move(z);
+  CPPUNIT_ASSERT( z.empty() );
+  CPPUNIT_ASSERT( x.get_extent().storage() == bytes );
+  CPPUNIT_ASSERT( x.descriptor().label == 1 );
+  x = std::move(x);
+  CPPUNIT_ASSERT( x.size() == test_size );
+
+  // a growing vector moves the tapes instead of copying them
+  std::vector<vbyte_tape> tapes;
+  tapes.push_back(vbytes);
+  bytes = tapes[0].get_extent().storage();
+  for (size_t i = 0; i < 100; ++i) tapes.push_back(vbyte_tape(test_data, test_data + i % test_size));
+  CPPUNIT_ASSERT( tapes[0].get_extent().storage() == bytes );
+  CPPUNIT_ASSERT( tapes[0] == vbytes );
+
+  std::vector<small_tape> small_tapes;
+  for (size_t i = 0; i < 100; ++i) small_tapes.push_back(small_tape(test_data, test_data + i % test_size));
+  small_tape large(std::move(small_tapes[99]));
+  CPPUNIT_ASSERT( small_tapes[99].empty() );
+  CPPUNIT_ASSERT( std::equal(large.begin(), large.end(), test_data) );
+  small_tapes[0] = std::move(large);
+  CPPUNIT_ASSERT( large.empty() );
+  for (size_t i = 1; i < 99; ++i) {
+    CPPUNIT_ASSERT( small_tapes[i].size() == i % test_size );
+    CPPUNIT_ASSERT( std::equal(small_tapes[i].begin(), small_tapes[i].end(), test_data) );
+  }
+  std::sort(small_tapes.begin(), small_tapes.end());
+  CPPUNIT_ASSERT( std::is_sorted(small_tapes.begin(), small_tapes.end()) );
+#endif
+}
+
+void TapeTest::testSharedExtent() {
+  typedef tape<vbyte_descriptor, malloc_allocator, doubling_growth, shared_extent> shared_tape;
+  CPPUNIT_ASSERT( sizeof(shared_tape) == sizeof(vbyte_tape) );
+
+  shared_tape x(test_data, test_data_end);
+  CPPUNIT_ASSERT( x.get_extent().use_count() == 1 );
+  shared_tape y(x);
+  shared_tape z;
+  z = y;
+  CPPUNIT_ASSERT( x.get_extent().use_count() == 3 );
+  CPPUNIT_ASSERT( y.get_extent().storage() == x.get_extent().storage() );
+  CPPUNIT_ASSERT( z == x );
+
+  // writing copies
+  y.push_back(7);
+  CPPUNIT_ASSERT( y.get_extent().storage() != x.get_extent().storage() );
+  CPPUNIT_ASSERT( x.get_extent().use_count() == 2 );
+  CPPUNIT_ASSERT( y.get_extent().use_count() == 1 );
+  CPPUNIT_ASSERT( x.size() + 1 == y.size() );
+  CPPUNIT_ASSERT( std::equal(x.begin(), x.end(), test_data) );
+  CPPUNIT_ASSERT( std::equal(x.begin(), x.end(), y.begin()) );
+  CPPUNIT_ASSERT( std::equal(z.begin(), z.end(), test_data) );
+
+  // inserting and erasing in the middle of a shared block
+  shared_tape u(x);
+  shared_tape::const_iterator first = u.begin();
+  ++first;
+  u.insert(first, test_data, test_data + 2);
+  CPPUNIT_ASSERT( u.size() == x.size() + 2 );
+  CPPUNIT_ASSERT( *++u.begin() == test_data[0] );
+  shared_tape w(x);
+  first = w.begin();
+  ++first;
+  w.erase(first, w.end());
+  CPPUNIT_ASSERT( w.size() == 1 );
+  CPPUNIT_ASSERT( *w.begin() == test_data[0] );
+  CPPUNIT_ASSERT( std::equal(x.begin(), x.end(), test_data) );
+  CPPUNIT_ASSERT( x.get_extent().use_count() == 2 );
+
+  // inserting an input range in the middle of a shared block
+  shared_tape s(x);
+  first = s.begin();
+  std::advance(first, 2);
+  std::istringstream in("5 6 7");
+  s.insert(first, std::istream_iterator<uint64_t>(in), std::istream_iterator<uint64_t>());
+  std::vector<uint64_t> expected(test_data, test_data_end);
+  uint64_t inserted[3] = {5, 6, 7};
+  expected.insert(expected.begin() + 2, inserted, inserted + 3);
+  CPPUNIT_ASSERT( s.size() == expected.size() );
+  CPPUNIT_ASSERT( std::equal(expected.begin(), expected.end(), s.begin()) );
+  CPPUNIT_ASSERT( std::equal(x.begin(), x.end(), test_data) );
+
+  // the iterator returned by erase is in the copied block
+  shared_tape e(x);
+  first = e.begin();
+  ++first;
+  shared_tape::const_iterator last = first;
+  ++last;
+  first = e.erase(first, last);
+  CPPUNIT_ASSERT( first.state().position >= e.get_extent().storage() &&
+                  first.state().position < e.get_extent().content_end() );
+  CPPUNIT_ASSERT( *first == test_data[2] );
+  e.insert(first, test_data + 1, test_data + 2);
+  CPPUNIT_ASSERT( std::equal(e.begin(), e.end(), test_data) );
+  CPPUNIT_ASSERT( std::equal(x.begin(), x.end(), test_data) );
+
+  shared_tape v(x);
+  v.erase(v.begin(), v.end());
+  CPPUNIT_ASSERT( v.empty() );
+  CPPUNIT_ASSERT( v.get_extent().use_count() == 0 );
+  CPPUNIT_ASSERT( x.size() == z.size() );
+  v.adjust_byte_capacity(0);
+
+  z = shared_tape();
+  CPPUNIT_ASSERT( x.get_extent().use_count() == 1 );
+  const uint8_t* bytes = x.get_extent().storage();
+  x.push_back(7);
+  CPPUNIT_ASSERT( x == y );
+  x.adjust_byte_capacity(0);
+  CPPUNIT_ASSERT( x == y );
+  CPPUNIT_ASSERT( bytes != NULL );
+
+  std::vector<shared_tape> copies(100, y);
+  CPPUNIT_ASSERT( y.get_extent().use_count() == 101 );
+  copies.clear();
+  CPPUNIT_ASSERT( y.get_extent().use_count() == 1 );
+}
+
+void TapeTest::testAppend() {
+  std::vector<uint64_t> v;
+  zipf z(1 << 30);
+  for (int i = 0; i < 10000; ++i) v.push_back(z.random());
+  vbyte_tape expected(v.begin(), v.end());
+
+  // forward
+  vbyte_tape t;
+  t.append(v.begin(), v.begin());
+  CPPUNIT_ASSERT( t.empty() );
+  t.append(v.begin(), v.begin() + 100);
+  std::list<uint64_t> l(v.begin() + 100, v.end());
+  t.append(l.begin(), l.end());
+  CPPUNIT_ASSERT( t == expected );
+
+  // input, more than one buffer
+  std::stringstream ss;
+  std::copy(v.begin(), v.end(), std::ostream_iterator<uint64_t>(ss, " "));
+  vbyte_tape u;
+  u.push_back(v[0]);
+  u.append(std::istream_iterator<uint64_t>(ss), std::istream_iterator<uint64_t>());
+  CPPUNIT_ASSERT( u.size() == v.size() + 1 );
+  CPPUNIT_ASSERT( *u.begin() == v[0] );
+  CPPUNIT_ASSERT( std::equal(++u.begin(), u.end(), v.begin()) );
+
+  // inserting an input range in the middle
+  std::stringstream ss2("1 2 3");
+  vbyte_tape w(v.begin(), v.begin() + 2);
+  w.insert(++w.begin(), std::istream_iterator<uint64_t>(ss2), std::istream_iterator<uint64_t>());
+  uint64_t inserted[] = { v[0], 1, 2, 3, v[1] };
+  CPPUNIT_ASSERT( w.size() == 5 );
+  CPPUNIT_ASSERT( std::equal(w.begin(), w.end(), inserted) );
+
+  std::stringstream words("append input words");
+  tape<string_descriptor> s;
+  s.append(std::istream_iterator<std::string>(words), std::istream_iterator<std::string>());
+  CPPUNIT_ASSERT( s.size() == 3 );
+  CPPUNIT_ASSERT( *++s.begin() == "input" );
+
+  typedef tape<vbyte_descriptor, malloc_allocator, doubling_growth, small_extent> small_tape;
+  small_tape small;
+  small.append(v.begin(), v.begin() + 1);
+  CPPUNIT_ASSERT( small.get_extent().is_inline() );
+  small.append(v.begin() + 1, v.end());
+  CPPUNIT_ASSERT( small.size() == v.size() );
+  CPPUNIT_ASSERT( std::equal(small.begin(), small.end(), v.begin()) );
+
+  typedef tape<vbyte_descriptor, malloc_allocator, doubling_growth, shared_extent> shared_tape;
+  shared_tape shared(v.begin(), v.begin() + 10);
+  shared_tape copy(shared);
+  copy.append(v.begin() + 10, v.end());
+  CPPUNIT_ASSERT( shared.size() == 10 );
+  CPPUNIT_ASSERT( std::equal(copy.begin(), copy.end(), v.begin()) );
+}
+
+template <typename Tape, typename T>
+std::vector<T> decode_in_blocks(const Tape& t, size_t buffer_size) {
+  std::vector<T> result;
+  std::vector<T> buffer(buffer_size);
+  typename Tape::const_iterator cursor = t.begin();
+  size_t n;
+  while ((n = t.decode_block(cursor, &buffer[0], buffer_size)) != 0) {
+    result.insert(result.end(), buffer.begin(), buffer.begin() + n);
+  }
+  CPPUNIT_ASSERT( cursor == t.end() );
+  return result;
+}
+
+void TapeTest::testDecodeBlock() {
+  std::vector<uint64_t> v;
+  zipf z(1 << 20);
+  for (int i = 0; i < 10000; ++i) v.push_back(z.random());
+  vbyte_tape t(v.begin(), v.end());
+
+  std::vector<uint64_t> all(v.size() + 1);
+  CPPUNIT_ASSERT( t.decode_into(&all[0], all.size()) == &all[0] + v.size() );
+  CPPUNIT_ASSERT( std::equal(v.begin(), v.end(), all.begin()) );
+  uint64_t few[3];
+  CPPUNIT_ASSERT( t.decode_into(few, 3) == few + 3 );
+  CPPUNIT_ASSERT( std::equal(few, few + 3, v.begin()) );
+  CPPUNIT_ASSERT( vbyte_tape().decode_into(few, 3) == few );
+
+  CPPUNIT_ASSERT( (decode_in_blocks<vbyte_tape, uint64_t>(t, 1) == v) );
+  CPPUNIT_ASSERT( (decode_in_blocks<vbyte_tape, uint64_t>(t, 256) == v) );
+
+  // resuming from an iterator
+  vbyte_tape::const_iterator cursor = t.begin();
+  std::advance(cursor, 100);
+  CPPUNIT_ASSERT( t.decode_block(cursor, few, 0) == 0 );
+  CPPUNIT_ASSERT( t.decode_block(cursor, few, 3) == 3 );
+  CPPUNIT_ASSERT( std::equal(few, few + 3, v.begin() + 100) );
+  CPPUNIT_ASSERT( *cursor == v[103] );
+
+  // descriptors with bulk kernels of their own
+  std::vector<uint32_t> w(v.begin(), v.end());
+  tape<stream_vbyte_descriptor> stream;
+  append_blocks(stream, w.begin(), w.end());
+  CPPUNIT_ASSERT( (decode_in_blocks<tape<stream_vbyte_descriptor>, uint32_t>(stream, 256) == w) );
+  tape<adaptive_descriptor> adaptive;
+  append_blocks(adaptive, v.begin(), v.end());
+  CPPUNIT_ASSERT( (decode_in_blocks<tape<adaptive_descriptor>, uint64_t>(adaptive, 300) == v) );
+
+  tape<string_descriptor> s;
+  s.push_back("decode");
+  s.push_back("block");
+  string_ref refs[2];
+  CPPUNIT_ASSERT( s.decode_into(refs, 2) == refs + 2 );
+  CPPUNIT_ASSERT( refs[1] == "block" );
+}
+
+void TapeTest::testSegmentedTape() {
+  typedef segmented_tape<vbyte_descriptor, malloc_allocator, 256> segmented_vbyte_tape;
+  std::vector<uint64_t> v;
+  zipf z(std::numeric_limits<uint32_t>::max());
+  for (int i = 0; i < 10000; ++i) v.push_back(z.random());
+
+  segmented_vbyte_tape t;
+  CPPUNIT_ASSERT( t.empty() && t.begin() == t.end() );
+  for (size_t i = 0; i < v.size(); ++i) t.push_back(v[i]);
+  CPPUNIT_ASSERT( t.size() == v.size() );
+  CPPUNIT_ASSERT( t.number_of_segments() > 1 );
+  CPPUNIT_ASSERT( size_t(std::distance(t.begin(), t.end())) == v.size() );
+  CPPUNIT_ASSERT( std::equal(v.begin(), v.end(), t.begin()) );
+
+  // no segment is reallocated, and no value is split between two
+  vbyte_tape whole(v.begin(), v.end());
+  CPPUNIT_ASSERT( t.byte_size() == whole.get_extent().byte_size() );
+  for (size_t i = 0; i < t.number_of_segments(); ++i) {
+    CPPUNIT_ASSERT( t.get_segments()[i].get_extent().byte_capacity() == 256 );
+  }
+
+  // backwards, across the segments
+  segmented_vbyte_tape::const_iterator i = t.end();
+  std::vector<uint64_t>::const_iterator j = v.end();
+  while (j != v.begin()) CPPUNIT_ASSERT( *--i == *--j );
+  CPPUNIT_ASSERT( i == t.begin() );
+
+  // appending forward and input ranges
+  segmented_vbyte_tape appended;
+  appended.append(v.begin(), v.begin() + 5000);
+  std::istringstream in;
+  std::ostringstream out;
+  std::copy(v.begin() + 5000, v.end(), std::ostream_iterator<uint64_t>(out, " "));
+  in.str(out.str());
+  appended.append(std::istream_iterator<uint64_t>(in), std::istream_iterator<uint64_t>());
+  CPPUNIT_ASSERT( appended == t );
+  CPPUNIT_ASSERT( segmented_vbyte_tape(v.begin(), v.end()) == t );
+  appended.push_back(1);
+  CPPUNIT_ASSERT( appended != t && t < appended );
+
+  // equal across segments ending at different values
+  segmented_vbyte_tape shifted(v.begin() + 77, v.end());
+  segmented_vbyte_tape::const_iterator first = t.begin();
+  std::advance(first, 77);
+  CPPUNIT_ASSERT( equal(first, t.end(), shifted.begin()) );
+  CPPUNIT_ASSERT( !equal(t.begin(), segmented_vbyte_tape::const_iterator(first), shifted.begin()) );
+
+  // copy decodes, or copies the bytes of each segment
+  std::vector<uint64_t> copied;
+  copy(t.begin(), t.end(), std::back_inserter(copied));
+  CPPUNIT_ASSERT( copied == v );
+  std::vector<uint8_t> bytes(t.byte_size());
+  typedef variable_size_output_iterator_basis<vbyte_descriptor> output_basis;
+  CPPUNIT_ASSERT( copy(t.begin(), t.end(),
+                       adapter::make_output_iterator(output_basis(&bytes[0], vbyte_descriptor())))
+                  .state().position == &bytes[0] + bytes.size() );
+  CPPUNIT_ASSERT( std::equal(bytes.begin(), bytes.end(), whole.get_extent().storage()) );
+
+  // decoding into buffers
+  std::vector<uint64_t> all(v.size() + 1);
+  CPPUNIT_ASSERT( t.decode_into(&all[0], all.size()) == &all[0] + v.size() );
+  CPPUNIT_ASSERT( std::equal(v.begin(), v.end(), all.begin()) );
+  CPPUNIT_ASSERT( (decode_in_blocks<segmented_vbyte_tape, uint64_t>(t, 1) == v) );
+  CPPUNIT_ASSERT( (decode_in_blocks<segmented_vbyte_tape, uint64_t>(t, 100) == v) );
+
+  // a value larger than a segment has a segment of its own
+  segmented_tape<string_descriptor, malloc_allocator, 16> strings;
+  strings.push_back("segmented");
+  strings.push_back("a string longer than a segment");
+  strings.push_back("tape");
+  CPPUNIT_ASSERT( strings.number_of_segments() == 3 );
+  CPPUNIT_ASSERT( *++strings.begin() == "a string longer than a segment" );
+
+  segmented_vbyte_tape u;
+  swap(t, u);
+  CPPUNIT_ASSERT( t.empty() && u.size() == v.size() );
+  u.clear();
+  CPPUNIT_ASSERT( u.empty() && u.number_of_segments() == 0 );
+}
+
+void TapeTest::testGapBufferTape() {
+  typedef gap_buffer_tape<vbyte_descriptor> gap_vbyte_tape;
+  std::vector<uint64_t> v;
+  zipf z(std::numeric_limits<uint32_t>::max());
+  for (int i = 0; i < 1000; ++i) v.push_back(z.random());
+
+  gap_vbyte_tape t(v.begin(), v.end());
+  CPPUNIT_ASSERT( t.size() == v.size() );
+  CPPUNIT_ASSERT( std::equal(v.begin(), v.end(), t.begin()) );
+
+  // a burst of insertions near one position
+  std::vector<uint64_t> expected(v);
+  gap_vbyte_tape::const_iterator position = t.begin();
+  std::advance(position, 500);
+  for (uint64_t i = 0; i < 300; ++i) {
+    position = t.insert(position, i * 1000);
+    ++position;
+    expected.insert(expected.begin() + 500 + i, i * 1000);
+    CPPUNIT_ASSERT( *position == expected[501 + i] );
+  }
+  CPPUNIT_ASSERT( t.get_extent().gap_size() > 0 );
+  CPPUNIT_ASSERT( t.size() == expected.size() );
+  CPPUNIT_ASSERT( size_t(std::distance(t.begin(), t.end())) == expected.size() );
+  CPPUNIT_ASSERT( std::equal(expected.begin(), expected.end(), t.begin()) );
+
+  // iterating backwards over the gap
+  gap_vbyte_tape::const_iterator i = t.end();
+  std::vector<uint64_t>::const_iterator j = expected.end();
+  while (j != expected.begin()) CPPUNIT_ASSERT( *--i == *--j );
+  CPPUNIT_ASSERT( i == t.begin() );
+
+  // erasures, and insertions of ranges, elsewhere
+  position = t.begin();
+  std::advance(position, 100);
+  gap_vbyte_tape::const_iterator last = position;
+  std::advance(last, 50);
+  position = t.erase(position, last);
+  expected.erase(expected.begin() + 100, expected.begin() + 150);
+  CPPUNIT_ASSERT( *position == expected[100] );
+  position = t.erase(position);
+  expected.erase(expected.begin() + 100);
+  std::pair<gap_vbyte_tape::const_iterator, gap_vbyte_tape::const_iterator> inserted =
+    t.insert(position, v.begin(), v.begin() + 10);
+  expected.insert(expected.begin() + 100, v.begin(), v.begin() + 10);
+  CPPUNIT_ASSERT( std::distance(inserted.first, inserted.second) == 10 );
+  CPPUNIT_ASSERT( *inserted.second == expected[110] );
+  std::istringstream in("1 2 3");
+  t.insert(t.begin(), std::istream_iterator<uint64_t>(in), std::istream_iterator<uint64_t>());
+  uint64_t three[3] = {1, 2, 3};
+  expected.insert(expected.begin(), three, three + 3);
+  t.push_back(7);
+  expected.push_back(7);
+  CPPUNIT_ASSERT( t.size() == expected.size() );
+  CPPUNIT_ASSERT( std::equal(expected.begin(), expected.end(), t.begin()) );
+  CPPUNIT_ASSERT( t == gap_vbyte_tape(expected.begin(), expected.end()) );
+
+  // closing the gap leaves the bytes of a tape
+  t.close_gap();
+  CPPUNIT_ASSERT( t.get_extent().gap_size() == 0 );
+  vbyte_tape contiguous(expected.begin(), expected.end());
+  CPPUNIT_ASSERT( t.get_extent().byte_size() == contiguous.get_extent().byte_size() );
+  CPPUNIT_ASSERT( std::equal(t.get_extent().storage(), t.get_extent().content_end(),
+                             contiguous.get_extent().storage()) );
+
+  // erasing everything frees the block
+  t.erase(t.begin(), t.end());
+  CPPUNIT_ASSERT( t.empty() && t.size() == 0 && t.begin() == t.end() );
+
+  // inserting or erasing nothing after the gap
+  uint64_t ten[10] = {0, 1, 2, 3, 4, 5, 6, 7, 8, 9};
+  gap_vbyte_tape g(ten, ten + 10);
+  g.move_gap(2);
+  g.insert(g.begin(), 100);
+  position = g.begin();
+  std::advance(position, 6);
+  std::vector<uint64_t> none;
+  inserted = g.insert(position, none.begin(), none.end());
+  CPPUNIT_ASSERT( inserted.first == position && inserted.second == position );
+  CPPUNIT_ASSERT( *inserted.first == 5 );
+  CPPUNIT_ASSERT( std::distance(inserted.first, g.end()) == 5 );
+  position = g.erase(position, position);
+  CPPUNIT_ASSERT( *position == 5 );
+
+  // a gap at the beginning
+  gap_buffer_tape<string_descriptor> s;
+  s.push_back("gap");
+  s.insert(s.begin(), "buffer");
+  s.insert(s.begin(), "a");
+  CPPUNIT_ASSERT( s.size() == 3 );
+  CPPUNIT_ASSERT( *s.begin() == "a" && *++s.begin() == "buffer" );
+}
 
 // Not currently run
 /*
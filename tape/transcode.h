@@ -0,0 +1,89 @@
+#ifndef TRANSCODE_H
+#define TRANSCODE_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <utility>
+
+#include "variable_size_type.h"
+#include "tape.h"
+
+/*
+
+transcode re-encodes the values of a tape with another descriptor.
+
+Pushing the values one at a time calls extent::insert_space for every
+value, and constructing the new tape from the iterators of the old one
+decodes every value twice, once to compute the size and once to encode.
+transcode decodes the source a buffer at a time with decode_n (using the
+bulk kernel of the descriptor, if it has one) and appends every buffer to
+the result with a single append, so the source is decoded once.
+
+The result is allocated once, before the first buffer is appended, with
+the size of the source scaled by the ratio of the sizes of the first
+buffer in the two encodings, plus an eighth; at the end the unused
+capacity is given back, which shrinks the block in place.  Only a
+source whose values grow much more than those of its first buffer makes
+the result grow again.  Computing the exact size would need a second
+decode of the whole source.
+
+Both descriptors must be element descriptors (not block descriptors), and
+the value type of the source must be convertible to the value type of
+the result.  The tapes can have any allocation and growth policies and
+extents.
+
+*/
+
+// replaces the values of result with those of x
+
+template <typename SourceTape, typename ResultTape>
+void transcode(const SourceTape& x, ResultTape& result) {
+  typedef typename SourceTape::descriptor_type source_descriptor;
+  typedef typename source_descriptor::value_type value_type;
+  const size_t buffer_size = 1024;
+  value_type buffer[buffer_size];
+  const uint8_t* first = x.get_extent().storage();
+  const uint8_t* last = x.get_extent().content_end();
+  const source_descriptor source_dsc = x.descriptor();
+
+  ResultTape tmp(result.descriptor());
+  if (first != last) {
+    std::pair<const uint8_t*, value_type*> r =
+      decode_n(first, last, buffer_size, buffer, source_dsc);
+    size_t source_bytes = size_t(r.first - first);
+    size_t result_bytes = total_encoded_size(buffer, r.second, tmp.descriptor()).first;
+    size_t estimate = result_bytes +
+      size_t(double(last - r.first) * double(result_bytes) / double(source_bytes));
+    tmp.adjust_byte_capacity(estimate + estimate / 8);
+    tmp.append(buffer, r.second);
+    first = r.first;
+  }
+  while (first != last) {
+    std::pair<const uint8_t*, value_type*> r =
+      decode_n(first, last, buffer_size, buffer, source_dsc);
+    tmp.append(buffer, r.second);
+    first = r.first;
+  }
+  tmp.adjust_byte_capacity(0);
+  swap(result, tmp);
+}
+
+template <typename WritableVariableSizeTypeDescriptor,
+          typename VariableSizeTypeDescriptor,
+          typename Allocator, typename Growth,
+          template <typename, typename, typename, typename> class Extent>
+tape<WritableVariableSizeTypeDescriptor>
+transcode(const tape<VariableSizeTypeDescriptor, Allocator, Growth, Extent>& x,
+          const WritableVariableSizeTypeDescriptor& dsc =
+            WritableVariableSizeTypeDescriptor()) {
+  tape<WritableVariableSizeTypeDescriptor> result(dsc);
+  transcode(x, result);
+  return result;
+}
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 2
+// indent-tabs-mode: nil
+// End:
+#endif
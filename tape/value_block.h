@@ -0,0 +1,188 @@
+#ifndef VALUE_BLOCK_H
+#define VALUE_BLOCK_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <iterator>
+#include <algorithm>
+
+#include "iterator_adapter.h"
+
+/*
+
+Block-structured codecs (stream VByte, PFOR, ...) cannot decode a single
+value without looking at a shared header, so they do not satisfy
+VariableSizeTypeDescriptor with integral value types.  They do satisfy it
+when the value type is a block of values: the tape then stores a sequence
+of blocks and block_element_iterator_basis flattens it back into a
+sequence of values.
+
+value_block is a Regular type holding up to N values.  It is a value
+type, so copying it copies the values; N should be small enough for that
+to be cheap compared to decoding.
+
+*/
+
+template <typename T, size_t N>
+struct value_block {
+  typedef T value_type;
+  typedef const T* const_iterator;
+  typedef size_t size_type;
+  enum { capacity = N };
+
+  size_t count;
+  T values[N];
+
+  value_block() : count(0) {}
+
+  template <typename InputIterator>
+  value_block(InputIterator first, InputIterator last) : count(0) {
+    while (first != last && count != N) values[count++] = *first++;
+  }
+
+  size_t size() const { return count; }
+  bool empty() const { return count == 0; }
+  bool full() const { return count == N; }
+
+  const T* begin() const { return values; }
+  const T* end() const { return values + count; }
+
+  void push_back(const T& x) { values[count++] = x; } // requires !full()
+
+  friend
+  bool operator==(const value_block& x, const value_block& y) {
+    return x.count == y.count && std::equal(x.begin(), x.end(), y.begin());
+  }
+
+  friend
+  bool operator!=(const value_block& x, const value_block& y) {
+    return !(x == y);
+  }
+
+  friend
+  bool operator<(const value_block& x, const value_block& y) {
+    return std::lexicographical_compare(x.begin(), x.end(), y.begin(), y.end());
+  }
+};
+
+
+// BlockIterator is a forward iterator whose value type is value_block;
+// the basis visits the values of the blocks in order, decoding every block
+// once.  Given the end of the blocks it skips the empty ones; without it
+// the blocks must not be empty (as append_blocks makes them)
+
+template <typename BlockIterator>
+struct block_element_iterator_basis {
+  typedef typename std::iterator_traits<BlockIterator>::value_type block_type;
+  typedef typename block_type::value_type value_type;
+  typedef std::forward_iterator_tag iterator_category;
+  typedef ptrdiff_t difference_type;
+  typedef value_type reference;
+  typedef void pointer;
+
+  struct state_type {
+    BlockIterator block;
+    size_t index;
+    state_type() : index(0) {}
+    state_type(BlockIterator block, size_t index) : block(block), index(index) {}
+
+    friend
+    bool operator==(const state_type& x, const state_type& y) {
+      return x.block == y.block && x.index == y.index;
+    }
+  };
+
+private:
+  state_type st;
+  BlockIterator last;
+  bool bounded;
+  block_type cache;
+  bool cached;
+
+  void fill() {
+    cache = *st.block;
+    cached = true;
+  }
+
+  void skip_empty_blocks() {
+    if (!bounded) return;
+    while (st.block != last) {
+      fill();
+      if (cache.count) return;
+      ++st.block;
+    }
+    cached = false;
+  }
+
+public:
+  block_element_iterator_basis() : bounded(false), cached(false) {}
+
+  block_element_iterator_basis(BlockIterator block)
+    : st(block, 0), bounded(false), cached(false) {}
+
+  block_element_iterator_basis(BlockIterator block, BlockIterator last)
+    : st(block, 0), last(last), bounded(true), cached(false) {
+    skip_empty_blocks();
+  }
+
+  const state_type& state() const { return st; }
+
+  reference deref() const {
+    if (!cached) const_cast<block_element_iterator_basis*>(this)->fill();
+    return cache.values[st.index];
+  }
+
+  void increment() {
+    if (!cached) fill();
+    if (++st.index == cache.count) {
+      ++st.block;
+      st.index = 0;
+      cached = false;
+      skip_empty_blocks();
+    }
+  }
+};
+
+// requires the blocks from block on to be nonempty
+template <typename BlockIterator>
+inline
+adapter::iterator<block_element_iterator_basis<BlockIterator> >
+element_iterator(BlockIterator block) {
+  typedef block_element_iterator_basis<BlockIterator> basis;
+  return adapter::iterator<basis>(basis(block));
+}
+
+// the first value of the blocks of [block, last), skipping empty blocks;
+// element_iterator(last) is the end
+template <typename BlockIterator>
+inline
+adapter::iterator<block_element_iterator_basis<BlockIterator> >
+element_iterator(BlockIterator block, BlockIterator last) {
+  typedef block_element_iterator_basis<BlockIterator> basis;
+  return adapter::iterator<basis>(basis(block, last));
+}
+
+
+// appends the values of [first, last) to a tape of blocks, N at a time;
+// all blocks but the last are full
+
+template <typename BlockTape, typename InputIterator>
+void append_blocks(BlockTape& t, InputIterator first, InputIterator last) {
+  typedef typename BlockTape::value_type block_type;
+  block_type block;
+  while (first != last) {
+    block.push_back(*first++);
+    if (block.full()) {
+      t.push_back(block);
+      block.count = 0;
+    }
+  }
+  if (!block.empty()) t.push_back(block);
+}
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 2
+// indent-tabs-mode: nil
+// End:
+#endif
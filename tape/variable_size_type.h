@@ -6,6 +6,7 @@
   =  SemiRegular<X::value_type>
   // X::value_type is a type encoded by variable-size datum
   && IteratorCategory<X::iterator_category>
+    // is std::random_access_iterator_tag if X satisfies RandomAccessVariableSizeTypeDescriptor
     // is std::bidirectional_iterator_tag if X satisfies BidirectionalVariableSizeTypeDescriptor
     // is std::forward_iterator_tag otherwise
   && requires(X a,
@@ -53,6 +54,15 @@
        // attributes_backward may be faster than computing decode and size separately
      };
 
+  concept RandomAccessVariableSizeTypeDescriptor<BidirectionalVariableSizeTypeDescriptor X>
+  =  requires (X a, const uint8_t* p) {
+       size_t { a.datum_size() };
+       axiom { X::prefixed_size == true }
+       axiom { a.size(p) == a.datum_size() }
+       // every datum has the same size, so the n-th datum after p is at
+       // p + n * a.datum_size()
+     };
+
   concept WritableVariableSizeTypeDescriptor<VariableSizeTypeDescriptor X>
   =  requires (X a, const value_type& v, const uint8_t* src, uint8_t* dst) {
        uint8_t* { a.encode(v, dst) }; // encodes v to dst
@@ -68,7 +78,10 @@
 */
 
 
+#include <stdint.h>
 #include <stddef.h>
+#include <iterator>
+#include <utility>
 
 template <typename InputIterator, typename VariableSizeTypeDescriptor>
 std::pair<size_t, size_t>
@@ -83,6 +96,65 @@ total_encoded_size(InputIterator first, InputIterator last,
   return std::make_pair(result, n);
 }
 
+// encode_range writes the encodings of the values of [first, last) at dst,
+// which must have room for their total encoded size, and returns the
+// position following them.  Descriptors with faster bulk kernels provide
+// overloads (see vbyte_descriptor.h)
+
+template <typename InputIterator, typename WritableVariableSizeTypeDescriptor>
+uint8_t*
+encode_range(InputIterator first, InputIterator last, uint8_t* dst,
+             const WritableVariableSizeTypeDescriptor& dsc) {
+  while (first != last) {
+    dst = dsc.encode(*first, dst);
+    ++first;
+  }
+  return dst;
+}
+
+// points_into tells whether a value refers to bytes in [first, last).  A
+// value type that refers to the bytes of a tape instead of holding its
+// value (string_ref, tape_view) overloads it, so that tape::push_back of
+// a value read from the same tape copies it before moving the bytes
+
+template <typename T>
+bool points_into(const T&, const uint8_t*, const uint8_t*) { return false; }
+
+// unwrap_iterator returns the pointer underlying an iterator of
+// std::vector or std::string (with libstdc++ and libc++), so that the
+// overloads of the bulk functions for pointers apply to them, and any other
+// iterator unchanged
+
+template <typename Iterator>
+Iterator unwrap_iterator(Iterator i) { return i; }
+
+#if defined(__GLIBCXX__)
+template <typename T, typename Container>
+T* unwrap_iterator(__gnu_cxx::__normal_iterator<T*, Container> i) { return i.base(); }
+#elif defined(_LIBCPP_VERSION)
+template <typename T>
+T* unwrap_iterator(std::__wrap_iter<T*> i) { return i.base(); }
+#endif
+
+// decode_n decodes at most n values from the well-formed range [first, last)
+// into result and returns the pair of positions following the last read and
+// written values, so that a caller can resume from where it stopped.
+// Descriptors with faster bulk kernels provide overloads (see vbyte_descriptor.h)
+
+template <typename VariableSizeTypeDescriptor, typename OutputIterator>
+std::pair<const uint8_t*, OutputIterator>
+decode_n(const uint8_t* first, const uint8_t* last, size_t n,
+         OutputIterator result,
+         const VariableSizeTypeDescriptor& dsc) {
+  while (n && first != last) {
+    *result = dsc.decode(first);
+    ++result;
+    first += dsc.size(first);
+    --n;
+  }
+  return std::make_pair(first, result);
+}
+
 
 // Local Variables:
 // mode: c++
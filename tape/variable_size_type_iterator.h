@@ -65,7 +65,7 @@ public:
     : base(position, dsc) {}
 
   const typename base::state_type&
-  state() { return this->st; }
+  state() const { return this->st; }
 
   typename base::reference
   deref() const { return this->st.dsc.decode(this->st.position);  }
@@ -92,7 +92,7 @@ public:
     : base(position, dsc), origin(origin) {}
 
   const typename base::state_type&
-  state() { return this->st; }
+  state() const { return this->st; }
 
   typename base::reference 
   deref() const { return this->st.dsc.decode(this->st.position); }
@@ -103,6 +103,44 @@ public:
 };
 
 
+template <typename VariableSizeTypeDescriptor>
+struct variable_size_iterator_basis<VariableSizeTypeDescriptor,
+                                    true,
+                                    std::random_access_iterator_tag>
+  : variable_size_iterator_basis_base<VariableSizeTypeDescriptor>
+{
+private:
+  typedef variable_size_iterator_basis_base<VariableSizeTypeDescriptor> base;
+public:
+  variable_size_iterator_basis() {}
+
+  variable_size_iterator_basis(const uint8_t*,
+                               const uint8_t* position,
+                               const VariableSizeTypeDescriptor& dsc)
+    : base(position, dsc) {}
+
+  const typename base::state_type&
+  state() const { return this->st; }
+
+  typename base::reference
+  deref() const { return this->st.dsc.decode(this->st.position); }
+
+  void increment() { this->st.position += this->st.dsc.datum_size(); }
+
+  void decrement() { this->st.position -= this->st.dsc.datum_size(); }
+
+  void increment(typename base::difference_type n) {
+    this->st.position += n * typename base::difference_type(this->st.dsc.datum_size());
+  }
+
+  typename base::difference_type
+  difference(const variable_size_iterator_basis& x) const {
+    return (this->st.position - x.st.position) /
+      typename base::difference_type(this->st.dsc.datum_size());
+  }
+};
+
+
 template <typename VariableSizeTypeDescriptor>
 struct variable_size_iterator_basis<VariableSizeTypeDescriptor, 
                                    false, 
@@ -125,7 +163,7 @@ public:
   }
 
   const typename base::state_type&
-  state() { return this->st; }
+  state() const { return this->st; }
 
   typename base::reference
   deref() const { 
@@ -265,7 +303,7 @@ struct variable_size_output_iterator_basis {
                                       const descriptor_type& dsc) : 
     st(position, dsc) {}
 
-  const state_type& state() { return st; }
+  const state_type& state() const { return st; }
 
   void store(const value_type& v) { 
     st.position = st.dsc.encode(v, st.position);
@@ -3,12 +3,19 @@
 
 #include <stdint.h>
 #include <stddef.h>
+#include <string.h>
 #include <iterator>
 #include <utility>
 
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
 // Only included for "concepts"
 #include "variable_size_type.h"
 
+#include "cpu_dispatch.h"
+
 struct vbyte_descriptor {
   typedef uint64_t value_type;
   enum { equality_preserving = true };
@@ -31,18 +38,10 @@ struct vbyte_descriptor {
   // a well-formed sequence of bytes is the one which is generated by the encode function
   // for some value of uint64_t
 
+  // returns ceil(b / 7) for the b significant bits of value (at least one)
+  // without branching: (37 b + 219) >> 8 == ceil(b / 7) for 1 <= b <= 64
   size_t encoded_size(value_type value) const {
-    const value_type one(1);
-    if (value < (one << 7))       return size_t(1);
-    if (value < (one << 14))      return size_t(2);
-    if (value < (one << 21))      return size_t(3);
-    if (value < (one << 28))      return size_t(4);
-    if (value < (one << 35))      return size_t(5);
-    if (value < (one << 42))      return size_t(6);
-    if (value < (one << 49))      return size_t(7);
-    if (value < (one << 56))      return size_t(8);
-    if (value < (one << 63))      return size_t(9);
-                                  return size_t(10);
+    return size_t(2587 - 37 * unsigned(__builtin_clzll(value | 1))) >> 8;
   }
   // 10*7 > 64 > 9*7
 
@@ -131,6 +130,398 @@ struct vbyte_descriptor {
   }
 };
 
+/* Bulk decoding
+
+The byte-at-a-time loop in attributes has a data-dependent branch on
+every byte.  The bulk kernel below looks at a window of bytes at once,
+gathers their continuation bits into a mask (one bit per byte) and uses
+the mask to find where every value in the window ends, in the spirit of
+Masked VByte (Plaisance, Kurz, Lemire).  The common case of a window
+without any continuation bits is just a widening copy.  When the CPU has
+SSSE3 (see cpu_dispatch.h), runs of one and two-byte values are decoded with a shuffle
+table indexed by the mask, as in Masked VByte proper.
+
+A continuation mask satisfies:
+
+concept ContinuationMask<SemiRegular X>
+=  requires (X m, const uint8_t* p) {
+     size_t { X::width };   // the number of bytes examined, at most 32
+     uint32_t { m(p) };     // bit i is set iff p[i] >= 0x80
+   };
+*/
+
+// the word-at-a-time kernels load bytes into little-endian words
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+#define VBYTE_WORD_KERNELS
+#endif
+
+#ifdef VBYTE_WORD_KERNELS
+
+// gathers the value encoded in the n <= 8 bytes starting at p without
+// branching on n; requires 8 readable bytes at p
+inline
+uint64_t vbyte_gather_word(const uint8_t* p, size_t n) {
+  uint64_t w;
+  memcpy(&w, p, sizeof(w));
+  w &= ~uint64_t(0) >> (64 - 8 * n);
+  // squeeze out the continuation bits: 7-bit groups become 14, 28 and 56-bit groups
+  w = ((w & 0x7f007f007f007f00ull) >> 1) | (w & 0x007f007f007f007full);
+  w = ((w & 0x3fff00003fff0000ull) >> 2) | (w & 0x00003fff00003fffull);
+  return ((w & 0x0fffffff00000000ull) >> 4) | (w & 0x000000000fffffffull);
+}
+
+// gathers the value encoded in the 9 or 10 bytes starting at p;
+// requires 10 readable bytes at p
+inline
+uint64_t vbyte_gather_long(const uint8_t* p, size_t n) {
+  return vbyte_gather_word(p, 8)
+       | (uint64_t(p[8] & 0x7f) << 56)
+       | ((uint64_t(p[9]) << 63) & -uint64_t(n == 10));
+}
+
+// portable version: the multiplication moves the high bits of 8 bytes
+// into the top byte of the product
+struct vbyte_continuation_mask_swar {
+  enum { width = 8 };
+  uint32_t operator()(const uint8_t* p) const {
+    uint64_t word;
+    memcpy(&word, p, sizeof(word));
+    return uint32_t(((word & 0x8080808080808080ull) * 0x0002040810204081ull) >> 56);
+  }
+};
+
+#ifdef __SSE2__
+
+struct vbyte_continuation_mask_sse2 {
+  enum { width = 16 };
+  uint32_t operator()(const uint8_t* p) const {
+    return uint32_t(_mm_movemask_epi8(_mm_loadu_si128((const __m128i*)p)));
+  }
+};
+
+#endif
+
+// decodes the values starting at first whose last bytes are marked in ends
+// and returns the number of bytes they take
+inline
+size_t vbyte_decode_ends(const uint8_t* first, uint32_t ends, uint64_t*& result) {
+  size_t start(0);
+  while (ends) {
+    size_t end = size_t(__builtin_ctz(ends));
+    size_t n = end - start + 1;
+    *result++ = n <= 8 ? vbyte_gather_word(first + start, n)
+                       : vbyte_gather_long(first + start, n);
+    start = end + 1;
+    ends &= ends - 1;
+  }
+  return start;
+}
+
+template <typename ContinuationMask>
+std::pair<const uint8_t*, uint64_t*>
+vbyte_decode_windows(const uint8_t* first, const uint8_t* last,
+                     uint64_t* result, uint64_t* result_last,
+                     ContinuationMask continuation_mask) {
+  const size_t width = ContinuationMask::width;
+  const uint32_t window_mask = uint32_t((uint64_t(1) << width) - 1);
+  // a window holds at most width values, so we never write past result_last;
+  // the extra 8 bytes allow the gathers to read past the window
+  while (size_t(last - first) >= width + 8 && size_t(result_last - result) >= width) {
+    uint32_t mask = continuation_mask(first);
+    if (!mask) {
+      for (size_t i = 0; i < width; ++i) result[i] = first[i];
+      first += width;
+      result += width;
+      continue;
+    }
+    size_t start = vbyte_decode_ends(first, ~mask & window_mask, result);
+    if (start == 0) {
+      // the value is longer than the window: only possible when width < 10
+      std::pair<uint64_t, size_t> a = vbyte_descriptor().attributes(first);
+      *result++ = a.first;
+      start = a.second;
+    }
+    first += start;
+  }
+  return std::make_pair(first, result);
+}
+
+#ifdef TAPE_SSE41_KERNELS
+
+// For every pattern of continuation bits in 8 bytes, the table tells how
+// many leading values of one or two bytes the pattern holds, how many bytes
+// they take and how to shuffle their bytes into 16-bit lanes.
+struct vbyte_shuffle_table {
+  struct entry {
+    uint8_t count;        // 0 if the first value takes more than two bytes
+    uint8_t consumed;
+    uint8_t shuffle[16];  // an index of 0x80 makes pshufb write a zero
+  };
+  entry entries[256];
+
+  vbyte_shuffle_table() {
+    for (size_t mask = 0; mask < 256; ++mask) {
+      entry& e = entries[mask];
+      e.count = 0;
+      memset(e.shuffle, 0x80, sizeof(e.shuffle));
+      size_t i(0);
+      while (i < 8) {
+        if (!(mask >> i & 1)) {
+          e.shuffle[2 * e.count] = uint8_t(i);
+          i += 1;
+        } else if (i + 1 < 8 && !(mask >> (i + 1) & 1)) {
+          e.shuffle[2 * e.count] = uint8_t(i);
+          e.shuffle[2 * e.count + 1] = uint8_t(i + 1);
+          i += 2;
+        } else {
+          break;
+        }
+        ++e.count;
+      }
+      e.consumed = uint8_t(i);
+    }
+  }
+
+  static const vbyte_shuffle_table& instance() {
+    static const vbyte_shuffle_table table;
+    return table;
+  }
+};
+
+// stores the 8 16-bit lanes of x as 8 uint64_t values
+TAPE_TARGET_SSE41 inline
+void vbyte_store_lanes(__m128i x, uint64_t* result) {
+  const __m128i zero = _mm_setzero_si128();
+  __m128i low = _mm_unpacklo_epi16(x, zero);
+  __m128i high = _mm_unpackhi_epi16(x, zero);
+  _mm_storeu_si128((__m128i*)(result + 0), _mm_unpacklo_epi32(low, zero));
+  _mm_storeu_si128((__m128i*)(result + 2), _mm_unpackhi_epi32(low, zero));
+  _mm_storeu_si128((__m128i*)(result + 4), _mm_unpacklo_epi32(high, zero));
+  _mm_storeu_si128((__m128i*)(result + 6), _mm_unpackhi_epi32(high, zero));
+}
+
+// Masked VByte proper: runs of one and two-byte values are decoded 8 bytes
+// at a time with a single shuffle; longer values are gathered as in
+// vbyte_decode_windows
+TAPE_TARGET_SSE41 inline
+std::pair<const uint8_t*, uint64_t*>
+vbyte_decode_shuffle(const uint8_t* first, const uint8_t* last,
+                     uint64_t* result, uint64_t* result_last) {
+  const vbyte_shuffle_table& table = vbyte_shuffle_table::instance();
+  const __m128i low_group = _mm_set1_epi16(0x007f);
+  const __m128i high_group = _mm_set1_epi16(0x7f00);
+  const __m128i zero = _mm_setzero_si128();
+  while (last - first >= 16 + 8 && result_last - result >= 16) {
+    __m128i bytes = _mm_loadu_si128((const __m128i*)first);
+    uint32_t mask = uint32_t(_mm_movemask_epi8(bytes));
+    if (!mask) {
+      vbyte_store_lanes(_mm_unpacklo_epi8(bytes, zero), result);
+      vbyte_store_lanes(_mm_unpackhi_epi8(bytes, zero), result + 8);
+      first += 16;
+      result += 16;
+      continue;
+    }
+    const vbyte_shuffle_table::entry& e = table.entries[mask & 0xff];
+    if (e.count) {
+      __m128i lanes = _mm_shuffle_epi8(bytes, _mm_loadu_si128((const __m128i*)e.shuffle));
+      lanes = _mm_or_si128(_mm_and_si128(lanes, low_group),
+                           _mm_srli_epi16(_mm_and_si128(lanes, high_group), 1));
+      vbyte_store_lanes(lanes, result);
+      first += e.consumed;
+      result += e.count;
+    } else {
+      // a well-formed value takes at most 10 bytes, so one ends in the window
+      first += vbyte_decode_ends(first, ~mask & 0xffff, result);
+    }
+  }
+  return std::make_pair(first, result);
+}
+
+#endif
+
+#endif
+
+// the bulk counterpart of attributes: decodes at most n values of the
+// well-formed range [first, last) into result and returns the positions
+// following the last read and written values
+inline
+std::pair<const uint8_t*, uint64_t*>
+decode_n(const uint8_t* first, const uint8_t* last, size_t n,
+         uint64_t* result,
+         const vbyte_descriptor& dsc) {
+  uint64_t* result_last = result + n;
+  std::pair<const uint8_t*, uint64_t*> p(first, result);
+#if defined(VBYTE_WORD_KERNELS) && defined(TAPE_SSE41_KERNELS)
+  if (current_cpu_level() >= sse41_cpu) {
+    p = vbyte_decode_shuffle(p.first, last, p.second, result_last);
+  }
+#endif
+#if defined(VBYTE_WORD_KERNELS) && defined(__SSE2__)
+  p = vbyte_decode_windows(p.first, last, p.second, result_last,
+                           vbyte_continuation_mask_sse2());
+#elif defined(VBYTE_WORD_KERNELS)
+  p = vbyte_decode_windows(p.first, last, p.second, result_last,
+                           vbyte_continuation_mask_swar());
+#endif
+  // the tail is shorter than a window or the output is almost full
+  while (p.first != last && p.second != result_last) {
+    std::pair<uint64_t, size_t> a = dsc.attributes(p.first);
+    *p.second++ = a.first;
+    p.first += a.second;
+  }
+  return p;
+}
+
+/* Bulk encoding
+
+total_encoded_size and encode_range have overloads for arrays of
+uint64_t, which tape::insert uses when given pointers (as transcode does).
+
+The sizes are computed without branches: the scalar kernel by the lzcnt
+formula of encoded_size, the AVX2 kernel by counting the thresholds 2^7k
+that a value reaches (AVX2 has no vector lzcnt), and the AVX-512 kernel by
+the lzcnt formula on eight values at a time.
+
+The BMI2 encoder spreads the 7-bit groups of a value into bytes with a
+single pdep, sets the continuation bits of all but the last byte and
+stores the 8 bytes at once.  The store may write past the end of the
+value, but not past the end of the 7 values that follow it, since each
+takes at least a byte; the last 7 values and the values of more than 56
+bits are encoded by vbyte_descriptor::encode.
+*/
+
+inline
+size_t vbyte_total_size(const uint64_t* first, const uint64_t* last) {
+  vbyte_descriptor dsc;
+  size_t result(0);
+  while (first != last) result += dsc.encoded_size(*first++);
+  return result;
+}
+
+#ifdef TAPE_AVX2_KERNELS
+
+TAPE_TARGET_AVX2 inline
+size_t vbyte_total_size_avx2(const uint64_t* first, const uint64_t* last) {
+  // the size of x is 10 minus the number of k in [1, 9] with x >> 7k == 0;
+  // cmpeq adds -1 to the lane of every such k
+  const __m256i zero = _mm256_setzero_si256();
+  __m256i zeros = zero;
+  size_t n = size_t(last - first) / 4 * 4;
+  const uint64_t* vector_last = first + n;
+  while (first != vector_last) {
+    __m256i x = _mm256_loadu_si256((const __m256i*)first);
+    __m256i a = _mm256_add_epi64(_mm256_cmpeq_epi64(_mm256_srli_epi64(x, 7), zero),
+                                 _mm256_cmpeq_epi64(_mm256_srli_epi64(x, 14), zero));
+    __m256i b = _mm256_add_epi64(_mm256_cmpeq_epi64(_mm256_srli_epi64(x, 21), zero),
+                                 _mm256_cmpeq_epi64(_mm256_srli_epi64(x, 28), zero));
+    __m256i c = _mm256_add_epi64(_mm256_cmpeq_epi64(_mm256_srli_epi64(x, 35), zero),
+                                 _mm256_cmpeq_epi64(_mm256_srli_epi64(x, 42), zero));
+    __m256i d = _mm256_add_epi64(_mm256_cmpeq_epi64(_mm256_srli_epi64(x, 49), zero),
+                                 _mm256_cmpeq_epi64(_mm256_srli_epi64(x, 56), zero));
+    a = _mm256_add_epi64(_mm256_add_epi64(a, b), _mm256_add_epi64(c, d));
+    a = _mm256_add_epi64(a, _mm256_cmpeq_epi64(_mm256_srli_epi64(x, 63), zero));
+    zeros = _mm256_add_epi64(zeros, a);
+    first += 4;
+  }
+  uint64_t lanes[4];
+  _mm256_storeu_si256((__m256i*)lanes, zeros);
+  uint64_t result = 10 * uint64_t(n) + lanes[0] + lanes[1] + lanes[2] + lanes[3];
+  return size_t(result) + vbyte_total_size(first, last);
+}
+
+// requires 8 writable bytes at dst for all but the last 7 values
+TAPE_TARGET_AVX2 inline
+uint8_t* vbyte_encode_pdep(const uint64_t* first, const uint64_t* last, uint8_t* dst) {
+  vbyte_descriptor dsc;
+  while (last - first > 7) {
+    uint64_t x = *first++;
+    if (x >> 56) {
+      dst = dsc.encode(x, dst);
+      continue;
+    }
+    size_t n = dsc.encoded_size(x);
+    uint64_t word = _pdep_u64(x, 0x7f7f7f7f7f7f7f7full) |
+      (0x8080808080808080ull & ((uint64_t(1) << (8 * (n - 1))) - 1));
+    memcpy(dst, &word, sizeof(word));
+    dst += n;
+  }
+  while (first != last) dst = dsc.encode(*first++, dst);
+  return dst;
+}
+
+#endif
+
+#ifdef TAPE_AVX512_KERNELS
+
+TAPE_TARGET_AVX512 inline
+size_t vbyte_total_size_avx512(const uint64_t* first, const uint64_t* last) {
+  const __m512i one = _mm512_set1_epi64(1);
+  const __m512i numerator = _mm512_set1_epi64(2587);
+  const __m512i factor = _mm512_set1_epi64(37);
+  __m512i sum = _mm512_setzero_si512();
+  const uint64_t* vector_last = first + size_t(last - first) / 8 * 8;
+  while (first != vector_last) {
+    __m512i x = _mm512_loadu_si512((const void*)first);
+    __m512i zeros = _mm512_lzcnt_epi64(_mm512_or_si512(x, one));
+    // the maskz forms and the 32-bit product (the high halves are 0)
+    // avoid the intrinsics that GCC 12 defines with an undefined source
+    // operand, which -Wall reports as used uninitialized
+    __m512i size = _mm512_maskz_srli_epi64(0xff, _mm512_sub_epi64(numerator,
+                                                                  _mm512_mullo_epi32(zeros, factor)), 8);
+    sum = _mm512_add_epi64(sum, size);
+    first += 8;
+  }
+  __m256i half = _mm256_add_epi64(_mm512_maskz_extracti64x4_epi64(0xf, sum, 0),
+                                  _mm512_maskz_extracti64x4_epi64(0xf, sum, 1));
+  uint64_t lanes[4];
+  _mm256_storeu_si256((__m256i*)lanes, half);
+  return size_t(lanes[0] + lanes[1] + lanes[2] + lanes[3]) + vbyte_total_size(first, last);
+}
+
+#endif
+
+inline
+std::pair<size_t, size_t>
+total_encoded_size(const uint64_t* first, const uint64_t* last,
+                   const vbyte_descriptor&) {
+  size_t n = size_t(last - first);
+#ifdef TAPE_AVX512_KERNELS
+  if (current_cpu_level() >= avx512_cpu) {
+    return std::make_pair(vbyte_total_size_avx512(first, last), n);
+  }
+#endif
+#ifdef TAPE_AVX2_KERNELS
+  if (current_cpu_level() >= avx2_cpu) {
+    return std::make_pair(vbyte_total_size_avx2(first, last), n);
+  }
+#endif
+  return std::make_pair(vbyte_total_size(first, last), n);
+}
+
+inline
+std::pair<size_t, size_t>
+total_encoded_size(uint64_t* first, uint64_t* last,
+                   const vbyte_descriptor& dsc) {
+  return total_encoded_size((const uint64_t*)first, (const uint64_t*)last, dsc);
+}
+
+// requires room for the total encoded size at dst
+inline
+uint8_t* encode_range(const uint64_t* first, const uint64_t* last, uint8_t* dst,
+                      const vbyte_descriptor& dsc) {
+#if defined(TAPE_AVX2_KERNELS) && defined(VBYTE_WORD_KERNELS)
+  if (current_cpu_level() >= avx2_cpu) return vbyte_encode_pdep(first, last, dst);
+#endif
+  while (first != last) dst = dsc.encode(*first++, dst);
+  return dst;
+}
+
+inline
+uint8_t* encode_range(uint64_t* first, uint64_t* last, uint8_t* dst,
+                      const vbyte_descriptor& dsc) {
+  return encode_range((const uint64_t*)first, (const uint64_t*)last, dst, dsc);
+}
+
 // Local Variables:
 // mode: c++
 // c-basic-offset: 2
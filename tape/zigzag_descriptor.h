@@ -0,0 +1,107 @@
+#ifndef ZIGZAG_DESCRIPTOR_H
+#define ZIGZAG_DESCRIPTOR_H
+
+#include <stdint.h>
+#include <stddef.h>
+#include <iterator>
+#include <utility>
+
+// Only included for "concepts"
+#include "variable_size_type.h"
+
+#include "vbyte_descriptor.h"
+
+/*
+
+Signed integers for tapes.  vbyte_descriptor spends ten bytes on any
+negative value, since its two's complement representation has all the high
+bits set.  ZigZag encoding (as in Protocol Buffers) interleaves the
+negative and the non-negative values,
+
+  0 -> 0, -1 -> 1, 1 -> 2, -2 -> 3, 2 -> 4, ...
+
+so that values of small magnitude map to small unsigned values, which are
+then encoded by vbyte_descriptor.  The encoded data are vbyte data, so the
+descriptor is bidirectional and decode_n uses the bulk vbyte kernels.
+
+*/
+
+inline
+uint64_t zigzag_encode(int64_t x) {
+  return (uint64_t(x) << 1) ^ uint64_t(x >> 63);
+}
+
+inline
+int64_t zigzag_decode(uint64_t x) {
+  return int64_t((x >> 1) ^ (~(x & 1) + 1));
+}
+
+struct zigzag_descriptor {
+  typedef int64_t value_type;
+  enum { equality_preserving = true };
+  enum { order_preserving = false };
+  enum { prefixed_size = false };
+  typedef std::bidirectional_iterator_tag iterator_category;
+
+  vbyte_descriptor base;
+
+  uint8_t* encode(value_type x, uint8_t* dst) const {
+    return base.encode(zigzag_encode(x), dst);
+  }
+
+  size_t encoded_size(value_type x) const {
+    return base.encoded_size(zigzag_encode(x));
+  }
+
+  value_type decode(const uint8_t* p) const {
+    return zigzag_decode(base.decode(p));
+  }
+
+  size_t size(const uint8_t* p) const {
+    return base.size(p);
+  }
+
+  std::pair<value_type, size_t> attributes(const uint8_t* p) const {
+    std::pair<uint64_t, size_t> a = base.attributes(p);
+    return std::make_pair(zigzag_decode(a.first), a.second);
+  }
+
+  const uint8_t* previous(const uint8_t* origin,
+                          const uint8_t* current) const {
+    return base.previous(origin, current);
+  }
+
+  std::pair<value_type, size_t> attributes_backward(const uint8_t* origin,
+                                                    const uint8_t* current) const {
+    std::pair<uint64_t, size_t> a = base.attributes_backward(origin, current);
+    return std::make_pair(zigzag_decode(a.first), a.second);
+  }
+
+  std::pair<const uint8_t*, uint8_t*>
+  copy(const uint8_t* src, uint8_t* dst) const {
+    return base.copy(src, dst);
+  }
+};
+
+// decodes with the vbyte kernels into result, reinterpreted as unsigned,
+// and then maps the decoded values back in place
+inline
+std::pair<const uint8_t*, int64_t*>
+decode_n(const uint8_t* first, const uint8_t* last, size_t n,
+         int64_t* result,
+         const zigzag_descriptor& dsc) {
+  uint64_t* unsigned_result = reinterpret_cast<uint64_t*>(result);
+  std::pair<const uint8_t*, uint64_t*> p =
+    decode_n(first, last, n, unsigned_result, dsc.base);
+  for (uint64_t* i = unsigned_result; i != p.second; ++i) {
+    *i = uint64_t(zigzag_decode(*i));
+  }
+  return std::make_pair(p.first, result + (p.second - unsigned_result));
+}
+
+// Local Variables:
+// mode: c++
+// c-basic-offset: 2
+// indent-tabs-mode: nil
+// End:
+#endif